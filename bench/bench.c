@@ -0,0 +1,124 @@
+/* Evaluator benchmarks, build and run with `make bench'. */
+#include <time.h>
+
+#include "defaults.h"
+#include "error.h"
+#include "parse.h"
+#include "execute.h"
+#include "vm.h"
+#include "jit.h"
+
+typedef DataValue *(*Evaluator)(Context *, const ParseNode *);
+
+static const char *DEFINITIONS[] = {
+	"fib 0 = 0",
+	"fib 1 = 1",
+	"fib n = fib(n - 1) + fib(n - 2)",
+	"poly x = 3x^3 - 2x^2 + x - 7",
+	"polys 0 = 0",
+	"polys n = poly(n / 7) + sin(2pi / n) + polys(n - 1)",
+	"count (0, acc) = acc",
+	"count (n, acc) = count(n - 1, acc + n)",
+	"tuples 0 = 0",
+	"tuples n = (n, 2n, 3n, 4n, 5n, 6n, 7n, 8n) 5 + tuples(n - 1)",
+	"scopes 0 = 0",
+	"scopes n = (a * b + scopes(n - 1) where (a, b) = (n, n + 1))",
+	"total (x, ...rest) = x + total rest",
+	"total x = x",
+	"wave x = sin x * cos(x / 3) + sqrt(abs x) / (1 + x^2)",
+	"waves 0 = 0",
+	"waves n = wave n + wave(n / 2) + wave(2n) + waves(n - 1)",
+	"vector = (1:100000) ^ 2",
+	"vectors 0 = 0",
+	"vectors n = (3 * vector + n * vector) 1 + vectors(n - 1)",
+	"grid = (1:3000) / 7",
+};
+
+static const struct {
+	const char *name;
+	const char *source;
+	usize repeat;
+} CASES[] = {
+	{ "recursion", "fib 20", 5 },
+	{ "arithmetic", "polys 1000", 50 },
+	{ "accumulator", "count(1000, 0)", 50 },
+	{ "tuples", "tuples 1000", 50 },
+	{ "scopes", "scopes 1000", 50 },
+	{ "slices", "total (1:1000)", 50 },
+	{ "numeric", "waves 1000", 50 },
+	{ "arrays", "vectors 100", 5 },
+	{ "tabulate", "(wave grid) 1", 50 },
+};
+
+/// Processor time used, which time spent running other programs on
+/// a busy machine does not count towards.
+static f64 seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static f64 run(Evaluator evaluate, const char *source, usize repeat)
+{
+	Context *ctx = base_context();
+	for (usize i = 0; i < len(DEFINITIONS); ++i) {
+		ParseNode *defn = parse(DEFINITIONS[i]);
+		unlink_datavalue(evaluate(ctx, defn));
+		free_parsenode(defn);
+	}
+
+	ParseNode *tree = parse(source);
+	f64 start = seconds();
+	for (usize i = 0; i < repeat; ++i) {
+		DataValue *result = evaluate(ctx, tree);
+		if (result == NULL) {
+			handle_error();
+			exit(EXIT_FAILURE);
+		}
+		unlink_datavalue(result);
+	}
+	f64 elapsed = seconds() - start;
+
+	free_parsenode(tree);
+	// Functions link the context they are defined in, so it never
+	// unlinks down to nothing, free it (and the definitions) outright.
+	free_context(ctx);
+	return elapsed;
+}
+
+// Each case is run a few times, and the fastest kept, being the one
+// least disturbed by whatever else the machine was doing.
+#define TRIALS 5
+
+static f64 fastest(Evaluator evaluate, usize i)
+{
+	f64 best = run(evaluate, CASES[i].source, CASES[i].repeat);
+	for (usize trial = 1; trial < TRIALS; ++trial) {
+		f64 elapsed = run(evaluate, CASES[i].source, CASES[i].repeat);
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+int main(void)
+{
+	printf("%-12s %14s %14s %14s %9s %9s\n", "case", "tree (ms)",
+		"bytecode (ms)", "jit (ms)", "speedup", "jit");
+	for (usize i = 0; i < len(CASES); ++i) {
+		f64 tree = fastest(execute_tree, i);
+		f64 bytecode = fastest(execute, i);
+		jit_enabled = true;
+		f64 native = fastest(execute, i);
+		jit_enabled = false;
+		printf("%-12s %14.2f %14.2f %14.2f %8.2fx %8.2fx\n", CASES[i].name,
+			tree * 1e3, bytecode * 1e3, native * 1e3,
+			tree / bytecode, bytecode / native);
+	}
+	printf("\n");
+	display_pools(stdout);
+	display_caches(stdout);
+	display_jit(stdout);
+	return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include "defaults.h"
 #include "builtin.h"
+#include "displays.h"
 
 NumberNode num_to_float(NumberNode num)
 {
@@ -39,72 +40,77 @@ NumberNode num_to_int(NumberNode num)
 	return result;
 }
 
-NumberNode *upcast_pair(NumberNode lhs, NumberNode rhs)
-{
-	NumberNode *pair = malloc(2 * sizeof(NumberNode));
-
-	switch (lhs.type) {
-	case FLOAT: {
-		pair[0] = lhs;
-		pair[1] = num_to_float(rhs);
-		break;
-	}
-	case INT: {
-		switch (rhs.type) {
-		case INT: {
-			pair[0] = lhs;
-			pair[1] = rhs;
-			break;
-		}
-		case FLOAT: {
-			pair[0] = num_to_float(lhs);
-			pair[1] = rhs;
-			break;
-		}
-		default:
-			goto error;
-		}
-		break;
-	}
-	error:
-	default: {
-		ERROR_TYPE = EXECUTION_ERROR;
-		strcpy(ERROR_MSG, "Unsupported number type.");
-		return NULL;
-	}
-	}
-	return pair;
-}
-
 DataValue *builtin_sleep(DataValue seconds)
 {
 	NumberNode *num = type_check("sleep", ARG, T_NUMBER, &seconds);
 	if (num == NULL) return NULL;
 
-	NumberNode *time = malloc(sizeof(NumberNode));
-	*time = num_to_int(*num);
-	if (time->value.i < 0) time->value.i = 0;
+	NumberNode time = num_to_int(*num);
+	if (time.value.i < 0) time.value.i = 0;
 
-	sleep((unsigned)time->value.i);
-	return heap_data(T_NUMBER, time);
+	sleep((unsigned)time.value.i);
+	return number_data(time);
+}
+
+/// A math function over many numbers at once, from packed integers
+/// or floats to packed floats.  Each result is exactly what the function
+/// gives for that number alone, so the error is bounded by that of the
+/// `long double' libm functions behind them (a few ulps at most, see
+/// the glibc manual on errors in math functions), and a tuple gives the
+/// same numbers as its items would one by one.  Transcendental functions
+/// stay calls per number, as x87 floats have no vector instructions, but
+/// nothing is allocated for each of them.
+typedef void (*MathKernel)(const void *, NumberType, fsize *, usize);
+
+#define MATH_KERNEL(NAME, FUNC) \
+static void map_ ##NAME (const void *numbers, NumberType type, fsize *result, usize n) \
+{ \
+	if (type == INT) { \
+		const ssize *x = numbers; \
+		for (usize i = 0; i < n; ++i) \
+			result[i] = FUNC((fsize)x[i]); \
+	} else { \
+		const fsize *x = numbers; \
+		for (usize i = 0; i < n; ++i) \
+			result[i] = FUNC(x[i]); \
+	} \
+}
+
+/// Apply a math builtin to every item of a tuple.  Numbers of one type
+/// go through its kernel all together, anything else (nested tuples,
+/// or numbers of mixed types) through the builtin, item by item.
+static DataValue *map_math(FUNC_PTR(builtin), MathKernel kernel, const DataValue *input)
+{
+	const Tuple *tuple = input->value;
+	NumberArray numbers;
+	void *buffer = NULL;
+	if (!number_array(input, &numbers, &buffer))
+		return map_tuple(builtin, tuple);
+	DataValue *result = alloc_tuple(TUPLE_FLOATS, tuple->length);
+	kernel(numbers.numbers, numbers.type, ((Tuple *)result->value)->floats, tuple->length);
+	free(buffer);
+	return result;
 }
 
 #define MATH_WRAPPER(NAME, FUNC)\
+static fsize math_ ##NAME (fsize x) \
+{ \
+	return FUNC(x); \
+} \
+MATH_KERNEL(NAME, FUNC) \
 DataValue *builtin_ ##NAME (DataValue input) \
 { \
+	if (input.type == T_TUPLE) \
+		return map_math(builtin_ ##NAME, map_ ##NAME, &input); \
 	NumberNode *num = type_check(#NAME, ARG, T_NUMBER, &input); \
 	\
 	if (num == NULL) \
 		return NULL; \
 	\
-	NumberNode *new_num = malloc(sizeof(NumberNode)); \
-	\
 	NumberNode tmp = num_to_float(*num); \
-	tmp.value.f = FUNC(tmp.value.f); \
+	tmp.value.f = math_ ##NAME (tmp.value.f); \
 	\
-	memcpy(new_num, &tmp, sizeof(NumberNode)); \
-	DataValue *result = heap_data(T_NUMBER, new_num); \
-	return result; \
+	return number_data(tmp); \
 }
 
 // This is cheaty, but hey.
@@ -172,20 +178,55 @@ MATH_WRAPPER(ceil, ceil)
 MATH_WRAPPER(floor, floor)
 MATH_WRAPPER(Gamma, gamma_complete)
 
+#define MATH_PAIR(NAME) { builtin_ ##NAME, math_ ##NAME }
+
+/// The function of reals behind each `MATH_WRAPPER' builtin.
+static const struct {
+	FUNC_PTR(builtin);
+	MathFunction function;
+} math_functions[] = {
+	MATH_PAIR(sin), MATH_PAIR(sinh), MATH_PAIR(cos), MATH_PAIR(cosh),
+	MATH_PAIR(tan), MATH_PAIR(tanh), MATH_PAIR(exp), MATH_PAIR(abs),
+	MATH_PAIR(log), MATH_PAIR(log2), MATH_PAIR(ln), MATH_PAIR(sqrt),
+	MATH_PAIR(cbrt), MATH_PAIR(acos), MATH_PAIR(acosh), MATH_PAIR(asin),
+	MATH_PAIR(asinh), MATH_PAIR(atan), MATH_PAIR(atanh), MATH_PAIR(ceil),
+	MATH_PAIR(floor), MATH_PAIR(Gamma),
+};
+
+/// What a builtin computes of its argument, as a float, if it is
+/// one of the math functions, otherwise NULL.
+MathFunction math_function(FnPtr builtin)
+{
+	for (usize i = 0; i < len(math_functions); ++i)
+		if (math_functions[i].builtin == builtin.fn)
+			return math_functions[i].function;
+	return NULL;
+}
+
 DataValue *builtin_neg(DataValue input)
 {
+	if (input.type == T_TUPLE) {
+		const Tuple *tuple = input.value;
+		if (tuple->kind == TUPLE_ITEMS)
+			return map_tuple(builtin_neg, tuple);
+		// Packed numbers and ranges are multiplied by -1 all at once.
+		input.onstack = true;  // A copy, not to hold the result.
+		DataValue *minus_one = number_data((NumberNode){ INT, { .i = -1 } });
+		DataValue *result = binary_operation(OPR_MUL, minus_one, &input);
+		unlink_datavalue(minus_one);
+		return result;
+	}
 	NumberNode *num = type_check("-", RHS, T_NUMBER, &input);
 	if (num == NULL)
 		return NULL;
-	NumberNode *new_num = malloc(sizeof(NumberNode));
-	memcpy(new_num, num, sizeof(NumberNode));
-	switch (new_num->type) {
+	NumberNode new_num = *num;
+	switch (new_num.type) {
 	case INT: {
-		new_num->value.i *= -1;
+		new_num.value.i *= -1;
 		break;
 	}
 	case FLOAT: {
-		new_num->value.f *= -1.0f;
+		new_num.value.f *= -1.0f;
 		break;
 	}
 	default: {
@@ -194,100 +235,326 @@ DataValue *builtin_neg(DataValue input)
 		return NULL;
 	}
 	}
-	DataValue *result = heap_data(T_NUMBER, new_num);
-	return result;
+	return number_data(new_num);
 }
 
 DataValue *builtin_pos(DataValue input)
 {
+	if (input.type == T_TUPLE) {
+		const Tuple *tuple = input.value;
+		return tuple->kind == TUPLE_ITEMS
+			? map_tuple(builtin_pos, tuple)
+			: copy_data(&input);
+	}
 	NumberNode *num = type_check("+", RHS, T_NUMBER, &input);
 	if (num == NULL)
 		return NULL;
-	NumberNode *new_num = malloc(sizeof(NumberNode));
-	memcpy(new_num, num, sizeof(NumberNode));
-	return heap_data(T_NUMBER, new_num);
+	return number_data(*num);
 }
 
+static fsize factorial(fsize x)
+{
+	return gamma_complete(x + 1);
+}
+MATH_KERNEL(factorial, factorial)
+
 DataValue *builtin_factorial(DataValue input)
 {
+	if (input.type == T_TUPLE)
+		return map_math(builtin_factorial, map_factorial, &input);
 	NumberNode *num = type_check("!", LHS, T_NUMBER, &input);
 
 	if (num == NULL)
 		return NULL;
 
 	NumberNode tmp = num_to_float(*num);
-	NumberNode *new_num = malloc(sizeof(NumberNode));
-	memcpy(new_num, &tmp, sizeof(NumberNode));
-	new_num->value.f = gamma_complete(new_num->value.f + 1);
+	tmp.value.f = factorial(tmp.value.f);
 
-	DataValue *result = heap_data(T_NUMBER, new_num);
-	result->value = new_num;
-	return result;
+	return number_data(tmp);
 }
 
+/// Remember the results of a function by argument: `memo f', or
+/// `memo (f, size)' to keep at most `size' of them.  Functions which
+/// define functions may change what they compute, so are refused.
+DataValue *builtin_memo(DataValue input)
+{
+	DataValue *func = &input;
+	usize capacity = MEMO_DEFAULT_CAPACITY;
+	if (input.type == T_TUPLE) {
+		const Tuple *args = input.value;
+		if (args->length != 2 || args->kind != TUPLE_ITEMS) {
+			ERROR_TYPE = EXECUTION_ERROR;
+			strcpy(ERROR_MSG, "Expected a function, or a function and"
+				" a size for `memo'.");
+			return NULL;
+		}
+		func = args->items[0];
+		NumberNode *size = type_check("memo", ARG, T_NUMBER, args->items[1]);
+		if (size == NULL)
+			return NULL;
+		// Checked before converting, a float may be out of range.
+		fsize whole = size->type == FLOAT ? size->value.f : size->value.i;
+		if (!(whole >= 1)) {
+			ERROR_TYPE = EXECUTION_ERROR;
+			strcpy(ERROR_MSG, "Size of `memo' must be at least one.");
+			return NULL;
+		}
+		if (whole > MEMO_MAX_CAPACITY) {
+			ERROR_TYPE = EXECUTION_ERROR;
+			sprintf(ERROR_MSG, "Size of `memo' must be at most %d.",
+				MEMO_MAX_CAPACITY);
+			return NULL;
+		}
+		capacity = num_to_int(*size).value.i;
+	}
 
-#define BINARY_FUNCTION(NAME, OP) \
-NumberNode *num_ ## NAME (NumberNode lhs, NumberNode rhs) \
-{ \
-	NumberNode *upcasted = upcast_pair(lhs, rhs); \
-	if (upcasted == NULL) \
-		return NULL; \
-	\
-	NumberNode *result = upcasted + 0; \
-	\
-	switch (result->type) { \
-	case FLOAT: \
-		result->value.f = upcasted[0].value.f OP upcasted[1].value.f; \
-		break; \
-	case INT: \
-		result->value.i = upcasted[0].value.i OP upcasted[1].value.i; \
-		break; \
-	default: { \
-		ERROR_TYPE = EXECUTION_ERROR; \
-		strcpy(ERROR_MSG, "Unsupported number type."); \
-		return NULL; \
-	} \
-	} \
-	result = realloc(result, sizeof(NumberNode)); \
-	return result; \
+	Lambda *lambda = type_check("memo", ARG, T_LAMBDA, func);
+	if (lambda == NULL)
+		return NULL;
+	if (!memoizable(lambda)) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Cannot remember results of `%s',\n"
+			"  it defines functions, which may rebind globals.",
+			symbol_name(lambda->name));
+		return NULL;
+	}
+
+	Lambda *remembering = copy_lambda(lambda, lambda->scope);
+	remembering->memo = make_memo(capacity);
+	return heap_data(T_LAMBDA, remembering);
 }
 
-BINARY_FUNCTION(add, +)  // `num_add` function.
-BINARY_FUNCTION(sub, -)  // `num_sub` function.
-BINARY_FUNCTION(mul, *)  // `num_mul` function.
+static const char *type_name(u32 type)
+{
+	return type == ANY_TYPE ? "unknown" : display_datatype(type);
+}
 
-// `num_div` function is different, it always gives a float.
-NumberNode *num_div(NumberNode lhs, NumberNode rhs)
+/// Print each pattern of a function, called as `call', with the
+/// types inferred for the operands of its arithmetic.
+static void display_pattern_types(const char *call, const Lambda *lambda)
 {
-	NumberNode *result = malloc(sizeof(NumberNode));
-	result->type = FLOAT;
-	result->value.f = num_to_float(lhs).value.f / num_to_float(rhs).value.f;
-	return result;
+	const PatternTable *table = lambda->table;
+	for (usize i = 0; i < table->patterns.len; ++i) {
+		const LambdaPattern *lampat = &table->patterns.buf[i];
+		char pattern[256];
+		snprintf(pattern, sizeof(pattern), "%s %s",
+			call, display_parsetree(lampat->pattern));
+		if (lampat->body_type == LambdaBody) {
+			display_pattern_types(pattern, lampat->lambda);
+			continue;
+		}
+		printf("%s = %s\n", pattern, display_parsetree(lampat->body));
+		const Chunk *chunk = lampat->chunk;
+		for (usize j = 0; j < chunk->notes.len; ++j) {
+			const TypeNote *note = &chunk->notes.buf[j];
+			const char *operation = display_parsetree(note->node);
+			if (note->left == T_NUMBER && note->right == T_NUMBER)
+				printf("  %-30s unchecked\n", operation);
+			else
+				printf("  %-30s checked, %s %s %s\n", operation,
+					type_name(note->left),
+					operator_name(note->node->node.binary.op),
+					type_name(note->right));
+		}
+	}
 }
 
-NumberNode *num_pow(NumberNode lhs, NumberNode rhs)
+/// Show where arithmetic in a function is known to be on numbers,
+/// and so does not check its operands, and where it is not.
+DataValue *builtin_types(DataValue input)
 {
-	NumberNode *upcasted = upcast_pair(lhs, rhs);
-	if (upcasted == NULL)
+	Lambda *lambda = type_check("types", ARG, T_LAMBDA, &input);
+	if (lambda == NULL)
 		return NULL;
+	display_pattern_types(symbol_name(lambda->name), lambda);
+	return stack_data(T_NIL, NULL);
+}
 
-	NumberNode *result = upcasted + 0;
+/* --- Arithmetic, dispatched on the types of both operands --- */
 
-	switch (result->type) {
-	case FLOAT:
-		result->value.f = powl(upcasted[0].value.f, upcasted[1].value.f);
-		break;
-	case INT:
-		result->value.i = upcasted[1].value.i < 0
-			? ((fsize)1) / ipow(upcasted[0].value.i, -upcasted[1].value.i)
-			:  ipow(upcasted[0].value.i, upcasted[1].value.i);
-		break;
-	default: {
+/// Computes one operation for one pair of operand types.
+/// The result may be stored over either operand.
+typedef void (*NumberKernel)(const NumberNode *, const NumberNode *, NumberNode *);
+
+static inline fsize as_float(const NumberNode *num)
+{
+	return num->type == INT ? (fsize)num->value.i : num->value.f;
+}
+
+#define ADD(A, B) ((A) + (B))
+#define SUB(A, B) ((A) - (B))
+#define MUL(A, B) ((A) * (B))
+#define DIV(A, B) ((A) / (B))
+#define POW(A, B) powl(A, B)
+
+/// Kernels giving a float, for two floats and for mixed operands.
+#define FLOAT_KERNELS(NAME, APPLY) \
+static void NAME ## _float(const NumberNode *lhs, const NumberNode *rhs, NumberNode *result) \
+{ \
+	*result = (NumberNode){ FLOAT, { .f = APPLY(lhs->value.f, rhs->value.f) } }; \
+} \
+static void NAME ## _mixed(const NumberNode *lhs, const NumberNode *rhs, NumberNode *result) \
+{ \
+	*result = (NumberNode){ FLOAT, { .f = APPLY(as_float(lhs), as_float(rhs)) } }; \
+}
+
+#define INT_KERNEL(NAME, APPLY) \
+static void NAME ## _int(const NumberNode *lhs, const NumberNode *rhs, NumberNode *result) \
+{ \
+	*result = (NumberNode){ INT, { .i = APPLY(lhs->value.i, rhs->value.i) } }; \
+}
+
+// Integers only upcast when the other side is a float.
+#define KERNEL_TABLE(NAME, INT_INT) \
+static const NumberKernel NAME ## _kernels[NUMBER_TYPES][NUMBER_TYPES] = { \
+	[INT][INT]     = INT_INT, \
+	[INT][FLOAT]   = NAME ## _mixed, \
+	[FLOAT][INT]   = NAME ## _mixed, \
+	[FLOAT][FLOAT] = NAME ## _float, \
+};
+
+FLOAT_KERNELS(add, ADD)
+FLOAT_KERNELS(sub, SUB)
+FLOAT_KERNELS(mul, MUL)
+FLOAT_KERNELS(div, DIV)
+FLOAT_KERNELS(pow, POW)
+
+INT_KERNEL(add, ADD)
+INT_KERNEL(sub, SUB)
+INT_KERNEL(mul, MUL)
+
+// Negative powers of integers do not give integers.
+ssize int_pow(ssize base, ssize exponent)
+{
+	return exponent < 0
+		? ((fsize)1) / ipow(base, -exponent)
+		: ipow(base, exponent);
+}
+INT_KERNEL(pow, int_pow)
+
+KERNEL_TABLE(add, add_int)
+KERNEL_TABLE(sub, sub_int)
+KERNEL_TABLE(mul, mul_int)
+KERNEL_TABLE(div, div_mixed)  // Division always gives a float.
+KERNEL_TABLE(pow, pow_int)
+
+/// Apply the kernel for the types of the operands.  Pairs of types
+/// without a kernel (BIGINT, RATIO) are not supported yet.
+static inline bool dispatch(const NumberKernel kernels[NUMBER_TYPES][NUMBER_TYPES],
+	const NumberNode *lhs, const NumberNode *rhs, NumberNode *result)
+{
+	NumberKernel kernel = NULL;
+	if (lhs->type < NUMBER_TYPES && rhs->type < NUMBER_TYPES)
+		kernel = kernels[lhs->type][rhs->type];
+	if (kernel == NULL) {
 		ERROR_TYPE = EXECUTION_ERROR;
 		strcpy(ERROR_MSG, "Unsupported number type.");
-		return NULL;
+		return false;
 	}
+	kernel(lhs, rhs, result);
+	return true;
+}
+
+#define NUMERIC_FUNCTION(NAME) \
+bool num_ ## NAME (const NumberNode *lhs, const NumberNode *rhs, NumberNode *result) \
+{ \
+	return dispatch(NAME ## _kernels, lhs, rhs, result); \
+}
+
+NUMERIC_FUNCTION(add)  // `num_add` function.
+NUMERIC_FUNCTION(sub)  // `num_sub` function.
+NUMERIC_FUNCTION(mul)  // `num_mul` function.
+NUMERIC_FUNCTION(div)  // `num_div` function.
+NUMERIC_FUNCTION(pow)  // `num_pow` function.
+
+/* --- Arithmetic over packed numbers, a whole array at a time --- */
+
+/// Computes one operation on `n' pairs of numbers of given types.
+/// Plain loops, which the compiler vectorises.  The result may be
+/// stored over either operand.
+typedef void (*ArrayKernel)(const void *, const void *, void *, usize);
+
+enum { BOTH_ARRAYS, LHS_SCALAR, RHS_SCALAR, ARRAY_SHAPES };
+
+// Integer division gives a float, as for single numbers.
+#define FDIV(A, B) ((fsize)(A) / (B))
+
+#define ARRAY_KERNEL(NAME, APPLY, L, R, OUT, LI, RI) \
+static void NAME(const void *lhs, const void *rhs, void *result, usize n) \
+{ \
+	const L *a = lhs; \
+	const R *b = rhs; \
+	OUT *out = result; \
+	for (usize i = 0; i < n; ++i) \
+		out[i] = APPLY(a[LI], b[RI]); \
+}
+
+/// Kernels for pairs of arrays, and an array with a number on either side.
+#define ARRAY_SHAPE_KERNELS(NAME, APPLY, L, R, OUT) \
+	ARRAY_KERNEL(NAME ## _aa, APPLY, L, R, OUT, i, i) \
+	ARRAY_KERNEL(NAME ## _sa, APPLY, L, R, OUT, 0, i) \
+	ARRAY_KERNEL(NAME ## _as, APPLY, L, R, OUT, i, 0)
+
+#define ARRAY_SHAPE(NAME, SHAPE) { \
+	[INT]   = { [INT] = NAME ## _int_ ## SHAPE,   [FLOAT] = NAME ## _mixed_ ## SHAPE }, \
+	[FLOAT] = { [INT] = NAME ## _floatint_ ## SHAPE, [FLOAT] = NAME ## _float_ ## SHAPE }, \
+}
+
+// Mixed operands upcast to float in the usual C conversions.
+#define ARRAY_KERNELS(NAME, APPLY, INT_APPLY, INT_OUT) \
+	ARRAY_SHAPE_KERNELS(NAME ## _int,      INT_APPLY, ssize, ssize, INT_OUT) \
+	ARRAY_SHAPE_KERNELS(NAME ## _mixed,    APPLY,     ssize, fsize, fsize) \
+	ARRAY_SHAPE_KERNELS(NAME ## _floatint, APPLY,     fsize, ssize, fsize) \
+	ARRAY_SHAPE_KERNELS(NAME ## _float,    APPLY,     fsize, fsize, fsize) \
+static const ArrayKernel NAME ## _arrays[ARRAY_SHAPES][NUMBER_TYPES][NUMBER_TYPES] = { \
+	[BOTH_ARRAYS] = ARRAY_SHAPE(NAME, aa), \
+	[LHS_SCALAR]  = ARRAY_SHAPE(NAME, sa), \
+	[RHS_SCALAR]  = ARRAY_SHAPE(NAME, as), \
+};
+
+ARRAY_KERNELS(add, ADD, ADD, ssize)
+ARRAY_KERNELS(sub, SUB, SUB, ssize)
+ARRAY_KERNELS(mul, MUL, MUL, ssize)
+ARRAY_KERNELS(div, DIV, FDIV, fsize)
+ARRAY_KERNELS(pow, POW, int_pow, ssize)
+
+static const struct {
+	const ArrayKernel (*kernels)[NUMBER_TYPES][NUMBER_TYPES];
+	bool int_result;  // Whether integers give integers.
+} ARRAY_OPERATIONS[OPERATOR_KINDS] = {
+	[OPR_ADD] = { add_arrays, true },
+	[OPR_SUB] = { sub_arrays, true },
+	[OPR_MUL] = { mul_arrays, true },
+	[OPR_DIV] = { div_arrays, false },
+	[OPR_CARET] = { pow_arrays, true },
+	[OPR_STARSTAR] = { pow_arrays, true },
+};
+
+/// The type of numbers arithmetic on numbers of these types gives.
+NumberType array_result(OperatorKind op, NumberType lhs, NumberType rhs)
+{
+	return ARRAY_OPERATIONS[op].int_result && lhs == INT && rhs == INT
+		? INT : FLOAT;
+}
+
+/// Apply an arithmetic operator to each pair of numbers, a number on
+/// one side standing for itself in every pair, storing the `length'
+/// results (of type `array_result') at `result'.  False (with an error)
+/// if it cannot.
+bool array_operation(OperatorKind op, const NumberArray *lhs,
+	const NumberArray *rhs, usize length, void *result)
+{
+	usize shape = lhs->scalar ? LHS_SCALAR
+		: rhs->scalar ? RHS_SCALAR : BOTH_ARRAYS;
+	ArrayKernel kernel = NULL;
+	if (ARRAY_OPERATIONS[op].kernels != NULL
+	&&  lhs->type < NUMBER_TYPES && rhs->type < NUMBER_TYPES)
+		kernel = ARRAY_OPERATIONS[op].kernels[shape][lhs->type][rhs->type];
+	if (kernel == NULL) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		strcpy(ERROR_MSG, "Unsupported number type.");
+		return false;
 	}
-	result = realloc(result, sizeof(NumberNode));
-	return result;
+	kernel(lhs->numbers, rhs->numbers, result, length);
+	return true;
 }
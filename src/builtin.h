@@ -7,10 +7,13 @@
 #include "parse.h"
 #include "execute.h"
 #include "error.h"
+#include "memo.h"
+
+/// Math builtins as functions of reals (see `math_function').
+typedef fsize (*MathFunction)(fsize);
 
 NumberNode num_to_float(NumberNode);
 NumberNode num_to_int(NumberNode);
-NumberNode *upcast_pair(NumberNode, NumberNode);
 
 fsize gamma_func(float, fsize);
 fsize gammae(fsize);
@@ -40,22 +43,29 @@ DataValue *builtin_factorial(DataValue);
 DataValue *builtin_neg(DataValue);
 DataValue *builtin_pos(DataValue);
 DataValue *builtin_Gamma(DataValue);
+DataValue *builtin_memo(DataValue);
+DataValue *builtin_types(DataValue);
 
-NumberNode *num_add(NumberNode, NumberNode);
-NumberNode *num_sub(NumberNode, NumberNode);
-NumberNode *num_mul(NumberNode, NumberNode);
-NumberNode *num_div(NumberNode, NumberNode);
-NumberNode *num_pow(NumberNode, NumberNode);
+bool num_add(const NumberNode *, const NumberNode *, NumberNode *);
+bool num_sub(const NumberNode *, const NumberNode *, NumberNode *);
+bool num_mul(const NumberNode *, const NumberNode *, NumberNode *);
+bool num_div(const NumberNode *, const NumberNode *, NumberNode *);
+bool num_pow(const NumberNode *, const NumberNode *, NumberNode *);
+ssize int_pow(ssize, ssize);
+NumberType array_result(OperatorKind, NumberType, NumberType);
+bool array_operation(OperatorKind, const NumberArray *, const NumberArray *, usize, void *);
+MathFunction math_function(FnPtr);
 
-#define FUNC_PAIR(NAME) { #NAME, { builtin_##NAME } }
+#define FUNC_PAIR(NAME) { #NAME, { builtin_##NAME }, false }
 
 struct _func_name_pair {
 	char *name;
 	FnPtr function;
+	bool impure;  // Not to be evaluated ahead of time (see `fold').
 };
 
 static const struct _func_name_pair builtin_fns[] = {
-	FUNC_PAIR(sleep),
+	{ "sleep", { builtin_sleep }, true },
 	FUNC_PAIR(sin),
 	FUNC_PAIR(sinh),
 	FUNC_PAIR(cos),
@@ -65,30 +75,29 @@ static const struct _func_name_pair builtin_fns[] = {
 	FUNC_PAIR(exp),
 	FUNC_PAIR(abs),
 	FUNC_PAIR(log),
-	{ "log10", { builtin_log } },
+	{ "log10", { builtin_log }, false },
 	FUNC_PAIR(log2),
 	FUNC_PAIR(ln),
 	FUNC_PAIR(sqrt),
 	FUNC_PAIR(cbrt),
 	FUNC_PAIR(acos),
-	{ "arccos", { builtin_acos } },
+	{ "arccos", { builtin_acos }, false },
 	FUNC_PAIR(acosh),
-	{ "arccosh", { builtin_acosh } },
+	{ "arccosh", { builtin_acosh }, false },
 	FUNC_PAIR(asin),
-	{ "arcsin", { builtin_asin } },
+	{ "arcsin", { builtin_asin }, false },
 	FUNC_PAIR(asinh),
-	{ "arcsinh", { builtin_asinh } },
+	{ "arcsinh", { builtin_asinh }, false },
 	FUNC_PAIR(atan),
-	{ "arctan", { builtin_atan } },
+	{ "arctan", { builtin_atan }, false },
 	FUNC_PAIR(atanh),
-	{ "arctanh", { builtin_atanh } },
+	{ "arctanh", { builtin_atanh }, false },
 	FUNC_PAIR(ceil),
 	FUNC_PAIR(floor),
 	FUNC_PAIR(factorial),
-	{ "!", { builtin_factorial } },
 	FUNC_PAIR(neg),
-	{ "-", { builtin_neg } },
 	FUNC_PAIR(pos),
-	{ "+", { builtin_pos } },
 	FUNC_PAIR(Gamma),
+	{ "memo", { builtin_memo }, true },
+	{ "types", { builtin_types }, true },
 };
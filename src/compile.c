@@ -0,0 +1,463 @@
+#include "compile.h"
+#include "execute.h"
+#include "constant.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* --- Lowering of parse trees into bytecode --- */
+
+static void emit(Chunk *chunk, OpCode op, u32 arg)
+{
+	push(Instr, &chunk->code, INSTR(op, arg));
+}
+
+static u32 add_constant(Chunk *chunk, DataValue *constant)
+{
+	push(DataValue *, &chunk->constants, constant);
+	return chunk->constants.len - 1;
+}
+
+static u32 add_node(Chunk *chunk, const ParseNode *node)
+{
+	push(const ParseNode *, &chunk->nodes, node);
+	return chunk->nodes.len - 1;
+}
+
+static u32 add_lambda(Chunk *chunk, Lambda *lambda)
+{
+	push(Lambda *, &chunk->lambdas, lambda);
+	return chunk->lambdas.len - 1;
+}
+
+static u32 add_address(Chunk *chunk, Address addr)
+{
+	push(Address, &chunk->addresses, addr);
+	return chunk->addresses.len - 1;
+}
+
+/* --- Static scopes, for resolving variables ahead of time --- */
+
+/// Locals of a scope entered by the code being compiled.  Code runs
+/// straight through, so the slot every name is bound to is known at
+/// each point, as long as the scope is `exact'.  Definitions may or
+/// may not bind a new local (see `register_lambda_pattern'), after
+/// which only the slots already known can be relied upon.
+/// The type of what each slot holds is known the same way.
+typedef struct {
+	array(Symbol) slots;
+	array(u32) types;  // Of each slot, ANY_TYPE if not known.
+	bool exact;
+} StaticScope;
+
+typedef struct {
+	Chunk *chunk;
+	array(StaticScope) scopes;  // Innermost last.
+} Compiler;
+
+static void enter_scope(Compiler *c)
+{
+	StaticScope scope = { .exact = true };
+	init(scope.slots, 8);
+	init(scope.types, 8);
+	push(StaticScope, &c->scopes, scope);
+}
+
+static void leave_scope(Compiler *c)
+{
+	StaticScope *scope = &c->scopes.buf[--c->scopes.len];
+	free(scope->slots.buf);
+	free(scope->types.buf);
+}
+
+static ssize find_slot(const StaticScope *scope, Symbol name)
+{
+	for (usize i = 0; i < scope->slots.len; ++i)
+		if (scope->slots.buf[i] == name)
+			return i;
+	return -1;
+}
+
+/// Mirror `bind_local': rebinding reuses the slot, otherwise
+/// the name gets the next slot.
+static void declare(StaticScope *scope, Symbol name, u32 type)
+{
+	ssize slot = find_slot(scope, name);
+	if (slot >= 0) {
+		scope->types.buf[slot] = type;
+	} else if (scope->exact) {
+		push(Symbol, &scope->slots, name);
+		push(u32, &scope->types, type);
+	}
+}
+
+/// Declare the names bound by a successful `match_local' of a
+/// pattern, in the order it binds them.  A lone name is bound
+/// to the whole value, of the given type.
+static void declare_pattern(StaticScope *scope, const ParseNode *pattern, u32 type)
+{
+	if (pattern->type == IDENT_NODE) {
+		declare(scope, pattern->node.ident.symbol, type);
+		return;
+	}
+	while (is_operation(pattern, OPR_COMMA)) {
+		declare_pattern(scope, binary_left(pattern), ANY_TYPE);
+		pattern = binary_right(pattern);
+	}
+	if (is_operation(pattern, OPR_SPLAT))
+		pattern = unary_operand(pattern);
+	if (pattern->type == IDENT_NODE)
+		declare(scope, pattern->node.ident.symbol, ANY_TYPE);
+	else if (is_operation(pattern, OPR_COMMA))
+		declare_pattern(scope, pattern, ANY_TYPE);
+}
+
+/// Emit the fastest load of a variable the static scopes allow.
+/// Returns the type of the variable, if it is known.
+static u32 compile_load(Compiler *c, Symbol name)
+{
+	u32 depth = 0;
+	for (usize i = c->scopes.len; i-- > 0; ++depth) {
+		const StaticScope *scope = &c->scopes.buf[i];
+		ssize slot = find_slot(scope, name);
+		if (slot >= 0 && depth <= ADDRESS_MAX && slot <= ADDRESS_MAX) {
+			emit(c->chunk, OP_LOAD_LOCAL, add_address(c->chunk, (Address){
+				.depth = depth,
+				.slot = slot,
+				.name = name,
+			}));
+			return scope->types.buf[slot];
+		}
+		if (slot >= 0 || !scope->exact) {
+			// May be bound here after all, look it up by name.
+			emit(c->chunk, OP_LOAD, add_address(c->chunk,
+				(Address){ .name = name }));
+			return ANY_TYPE;
+		}
+	}
+	// Not bound in any of our scopes, so it must be in one of the
+	// scopes above, which may still gain new bindings (globals).
+	if (depth == 0 || depth > ADDRESS_MAX) {
+		emit(c->chunk, OP_LOAD, add_address(c->chunk,
+			(Address){ .name = name }));
+		return ANY_TYPE;
+	}
+	emit(c->chunk, OP_LOAD_OUTER, add_address(c->chunk, (Address){
+		.depth = depth,
+		.slot = 0,
+		.name = name,
+	}));
+	return ANY_TYPE;
+}
+
+/// Bindings made by a definition are only known at runtime.
+static void compile_define(Compiler *c, const ParseNode *defn)
+{
+	emit(c->chunk, OP_DEFINE, add_node(c->chunk, defn));
+	if (c->scopes.len == 0)
+		return;
+	const ParseNode *call = binary_left(defn);
+	while (is_application(call))
+		call = unary_callee(call);
+	// An existing function in one of our scopes only gains a pattern.
+	if (call->type == IDENT_NODE) {
+		Symbol name = call->node.ident.symbol;
+		for (usize i = c->scopes.len; i-- > 0;) {
+			const StaticScope *scope = &c->scopes.buf[i];
+			if (find_slot(scope, name) >= 0)
+				return;
+			if (!scope->exact)
+				break;
+		}
+	}
+	c->scopes.buf[c->scopes.len - 1].exact = false;
+}
+
+/// Mirror `export_locals' from the innermost scope to the scope two
+/// above it, when that scope is one of ours.
+static void compile_export(Compiler *c)
+{
+	emit(c->chunk, OP_EXPORT, 0);
+	if (c->scopes.len < 3)
+		return;
+	const StaticScope *from = &c->scopes.buf[c->scopes.len - 1];
+	StaticScope *to = &c->scopes.buf[c->scopes.len - 3];
+	if (!from->exact) {
+		// Any of the slots may be rebound, to anything.
+		to->exact = false;
+		for (usize i = 0; i < to->types.len; ++i)
+			to->types.buf[i] = ANY_TYPE;
+		return;
+	}
+	for (usize i = 0; i < from->slots.len; ++i)
+		declare(to, from->slots.buf[i], from->types.buf[i]);
+}
+
+/// Enter or leave a scope, in the bytecode and statically.
+static void compile_enter(Compiler *c, Symbol name)
+{
+	emit(c->chunk, OP_ENTER, name);
+	enter_scope(c);
+}
+
+static void compile_leave(Compiler *c)
+{
+	emit(c->chunk, OP_LEAVE, 0);
+	leave_scope(c);
+}
+
+
+// Arithmetic operators with their own instructions, indexed by operator.
+static const OpCode ARITHMETIC_OPS[OPERATOR_KINDS] = {
+	[OPR_ADD] = OP_ADD,
+	[OPR_SUB] = OP_SUB,
+	[OPR_MUL] = OP_MUL,
+	[OPR_DIV] = OP_DIV,
+	[OPR_CARET] = OP_POW,
+	[OPR_STARSTAR] = OP_POW,
+};
+
+static u32 compile_node(Compiler *, const ParseNode *);
+
+/// Emit the code matching the value on top of the stack against a
+/// pattern, the way `match_local' does, which pops it.  Tuple patterns
+/// take their value apart into the parts their elements match in turn.
+static void compile_pattern(Compiler *c, const ParseNode *pattern)
+{
+	if (pattern->type == IDENT_NODE) {
+		emit(c->chunk, OP_MATCH_NAME, pattern->node.ident.symbol);
+		return;
+	}
+	if (!is_operation(pattern, OPR_COMMA) && !is_operation(pattern, OPR_SPLAT)) {
+		emit(c->chunk, OP_MATCH, add_node(c->chunk, pattern));
+		return;
+	}
+	const ParseNode *last = pattern;
+	while (is_operation(last, OPR_COMMA))
+		last = binary_right(last);
+	bool splat = is_operation(last, OPR_SPLAT);
+	emit(c->chunk, OP_MATCH_TUPLE, MATCH_TUPLE(tuple_elements(pattern), splat));
+	for (const ParseNode *rest = pattern; rest != NULL;) {
+		const ParseNode *element = next_element(&rest);
+		if (element == last && splat)
+			element = unary_operand(element);
+		compile_pattern(c, element);
+	}
+}
+
+/// Arithmetic on operands of known types, which skips checking them
+/// when both are numbers.  The result is a number for two numbers, a
+/// tuple if either is a tuple (item by item), or an error.
+static u32 compile_arithmetic(Compiler *c, const ParseNode *node, u32 left, u32 right)
+{
+	OpCode op = ARITHMETIC_OPS[node->node.binary.op];
+	bool unchecked = left == T_NUMBER && right == T_NUMBER;
+	emit(c->chunk, op, unchecked ? ARITH_UNCHECKED : 0);
+	push(TypeNote, &c->chunk->notes, ((TypeNote){ node, left, right }));
+	if (unchecked)
+		return T_NUMBER;
+	return left == T_TUPLE || right == T_TUPLE ? T_TUPLE : ANY_TYPE;
+}
+
+static u32 compile_binary(Compiler *c, const ParseNode *node)
+{
+	const BinaryNode *binary = &node->node.binary;
+	const ParseNode *left = binary_left(node);
+	const ParseNode *right = binary_right(node);
+	u32 type = ANY_TYPE;
+
+	switch (binary->op) {
+	case OPR_ASSIGN:
+		if (is_application(left)) {
+			// Function definition, registered when executed.
+			compile_define(c, node);
+			return T_LAMBDA;
+		}
+		type = compile_node(c, right);
+		// The value is also that of the assignment.
+		emit(c->chunk, OP_DUP, 0);
+		compile_pattern(c, left);
+		if (c->scopes.len > 0)
+			declare_pattern(&c->scopes.buf[c->scopes.len - 1], left, type);
+		return type;
+	case OPR_ARROW: {
+		// The template owns a copy of its pattern and body, which
+		// closures of it share, so they may outlive this chunk.
+		Lambda *template = make_lambda(NULL, SYM_ANON,
+			left, right);
+		emit(c->chunk, OP_LAMBDA, add_lambda(c->chunk, template));
+		return T_LAMBDA;
+	}
+	case OPR_LET_IN:
+		// Bindings in their own scope, then the result in another.
+		compile_enter(c, SYM_LET_CLAUSE);
+		compile_node(c, left);
+		compile_enter(c, SYM_LET_EXPR);
+		type = compile_node(c, right);
+		compile_export(c);
+		compile_leave(c);
+		compile_leave(c);
+		emit(c->chunk, OP_NIP, 0);
+		return type;
+	case OPR_WHERE:
+		// Same as `let-in`, but with the sides swapped.
+		compile_enter(c, SYM_WHERE_CLAUSE);
+		compile_node(c, right);
+		compile_enter(c, SYM_WHERE_EXPR);
+		type = compile_node(c, left);
+		compile_export(c);
+		compile_leave(c);
+		compile_leave(c);
+		emit(c->chunk, OP_NIP, 0);
+		return type;
+	case OPR_COMMA: {
+		// Every element is pushed, then joined into one tuple.
+		Chunk *chunk = c->chunk;
+		TupleShape shape = { 0, chunk->splats.len };
+		bool splatted = false;
+		for (const ParseNode *rest = node; rest != NULL; ++shape.count) {
+			bool splat = is_operation(next_element(&rest), OPR_SPLAT);
+			push(bool, &chunk->splats, splat);
+			splatted |= splat;
+		}
+		for (const ParseNode *rest = node; rest != NULL;) {
+			const ParseNode *element = next_element(&rest);
+			if (is_operation(element, OPR_SPLAT))
+				element = unary_operand(element);
+			compile_node(c, element);
+		}
+		if (splatted) {
+			push(TupleShape, &chunk->shapes, shape);
+			emit(chunk, OP_TUPLE_SPLAT, chunk->shapes.len - 1);
+		} else {
+			chunk->splats.len = shape.splats;  // Not needed after all.
+			emit(chunk, OP_TUPLE, shape.count);
+		}
+		return T_TUPLE;
+	}
+	case OPR_RANGE:
+		compile_node(c, left);
+		compile_node(c, right);
+		emit(c->chunk, OP_RANGE, 0);
+		return T_TUPLE;
+	case OPR_SEMICOLON:
+		compile_node(c, left);
+		emit(c->chunk, OP_POP, 0);
+		return compile_node(c, right);
+	default: {
+		u32 left_type = compile_node(c, left);
+		u32 right_type = compile_node(c, right);
+		if (ARITHMETIC_OPS[binary->op] != 0)
+			return compile_arithmetic(c, node, left_type, right_type);
+		emit(c->chunk, OP_FAIL, binary->op);
+		return ANY_TYPE;
+	}
+	}
+}
+
+/// Emit the code for a node, which leaves its value on the stack.
+/// Returns the type of the value, as far as it can be inferred.
+static u32 compile_node(Compiler *c, const ParseNode *node)
+{
+	switch (node->type) {
+	case IDENT_NODE:
+		return compile_load(c, node->node.ident.symbol);
+	case NUMBER_NODE:
+		emit(c->chunk, OP_CONSTANT, add_constant(c->chunk,
+			constant_number(node->node.number)));
+		return T_NUMBER;
+	case STRING_NODE:
+		emit(c->chunk, OP_CONSTANT, add_constant(c->chunk,
+			constant_string(node->node.str)));
+		return T_STRING;
+	case UNARY_NODE: {
+		OperatorKind op = node->node.unary.op;
+		if (op != OPR_NONE) {
+			// Prefix/postfix operators.
+			u32 operand = compile_node(c, unary_operand(node));
+			emit(c->chunk, OP_UNARY, op);
+			// Numbers give numbers, tuples give tuples (item by item).
+			if (op == OPR_SPLAT)
+				return ANY_TYPE;
+			return operand == T_NUMBER || operand == T_TUPLE ? operand : ANY_TYPE;
+		}
+		u32 callee = compile_node(c, unary_callee(node));
+		u32 operand = compile_node(c, unary_operand(node));
+		emit(c->chunk, OP_CALL, 0);
+		// Juxtaposition of numbers is multiplication.
+		return callee == T_NUMBER && operand == T_NUMBER ? T_NUMBER : ANY_TYPE;
+	}
+	case BINARY_NODE:
+		return compile_binary(c, node);
+	default:
+		fprintf(stderr, "unhandled node: %d\n", node->type);
+		exit(2);
+	}
+}
+
+/// A call is in tail position when all that follows it is leaving
+/// the scopes around it, as in `f x where ...' or `a; f x'.  There is
+/// no branching, so only the last call of a chunk may be one.
+static void mark_tail_call(Chunk *chunk)
+{
+	for (usize i = chunk->code.len; i-- > 0;) {
+		switch (INSTR_OP(chunk->code.buf[i])) {
+		case OP_RETURN:
+		case OP_EXPORT:
+		case OP_LEAVE:
+		case OP_NIP:
+			continue;
+		case OP_CALL:
+			chunk->code.buf[i] = INSTR(OP_TAIL_CALL, 0);
+			return;
+		default:
+			return;
+		}
+	}
+}
+
+/// Compile a parse tree into a chunk of bytecode, which
+/// leaves the value of the tree on the stack and returns.
+/// For the body of a function, `pattern' is the pattern the call
+/// context was matched against, whose locals may then be addressed
+/// directly.  Otherwise (NULL), the context is not known statically.
+Chunk *compile(const ParseNode *tree, const ParseNode *pattern)
+{
+	// Constant tables are allocated on first use.
+	Compiler c = { .chunk = calloc(1, sizeof(Chunk)) };
+	init(c.chunk->code, 16);
+	init(c.scopes, 4);
+
+	if (pattern != NULL) {
+		enter_scope(&c);
+		declare_pattern(&c.scopes.buf[0], pattern, ANY_TYPE);
+	}
+
+	compile_node(&c, tree);
+	emit(c.chunk, OP_RETURN, 0);
+	mark_tail_call(c.chunk);
+	c.chunk->load_caches = calloc(c.chunk->addresses.len, sizeof(LoadCache));
+
+	while (c.scopes.len > 0)
+		leave_scope(&c);
+	free(c.scopes.buf);
+	return c.chunk;
+}
+
+/// Lambda templates are freed too, their patterns go with
+/// the last closure made from them.
+void free_chunk(Chunk *chunk)
+{
+	for (usize i = 0; i < chunk->lambdas.len; ++i)
+		free_lambda(chunk->lambdas.buf[i]);
+	free(chunk->code.buf);
+	free(chunk->constants.buf);
+	free(chunk->nodes.buf);
+	free(chunk->lambdas.buf);
+	free(chunk->addresses.buf);
+	free(chunk->shapes.buf);
+	free(chunk->splats.buf);
+	free(chunk->load_caches);
+	free(chunk->notes.buf);
+	free(chunk);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "defaults.h"
+#include "parse.h"
+
+struct _lambda;
+struct _datavalue;
+
+/// A single bytecode instruction.  The low byte holds the opcode,
+/// the upper 24 bits hold its operand (usually an index into one
+/// of the chunk's constant tables, or a symbol).
+typedef u32 Instr;
+
+#define INSTR(OP, ARG) ((Instr)(OP) | ((Instr)(ARG) << 8))
+#define INSTR_OP(INS)  ((OpCode)((INS) & 0xff))
+#define INSTR_ARG(INS) ((u32)(INS) >> 8)
+
+typedef enum {
+	OP_CONSTANT, // Push `constants[arg]'.
+	OP_LOAD,    // Push the variable named by `addresses[arg]', from any scope.
+	OP_LOAD_LOCAL, // Push the local at `addresses[arg]'.
+	OP_LOAD_OUTER, // Push a variable bound above `addresses[arg].depth'.
+	OP_CALL,    // Apply callee (second from top) to operand (top).
+	OP_TAIL_CALL, // OP_CALL, where the frame has nothing left to do.
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_POW,
+	OP_UNARY,   // Apply the prefix/postfix operator `arg' to top of stack.
+	OP_TUPLE,   // Join the top `arg' values into one tuple (see `join_tuple').
+	OP_TUPLE_SPLAT, // Join the elements of `shapes[arg]', some splatted.
+	OP_RANGE,   // Tuple of the integers between the top two values.
+	OP_DUP,     // Push top of stack again.
+	OP_MATCH_NAME,  // Pop top of stack, binding it to the symbol `arg'.
+	OP_MATCH_TUPLE, // Pop a tuple, pushing the parts a pattern takes apart.
+	OP_MATCH,   // Pop top of stack, to match pattern `nodes[arg]', binding nothing.
+	OP_DEFINE,  // Register the function definition `nodes[arg]'.
+	OP_LAMBDA,  // Push a new closure of the template `lambdas[arg]'.
+	OP_ENTER,   // Enter a new scope named by the symbol `arg'.
+	OP_EXPORT,  // Copy bindings of this scope to the scope two above.
+	OP_LEAVE,   // Leave the current scope.
+	OP_POP,     // Discard top of stack.
+	OP_NIP,     // Discard the value under the top of stack.
+	OP_FAIL,    // Operator `arg' is not evaluable; raise an error.
+	OP_RETURN,  // Return top of stack to the calling frame.
+} OpCode;
+
+// Flag for the operand of arithmetic instructions.
+#define ARITH_UNCHECKED 1  // Both operands are known to be numbers.
+
+// Operand of OP_MATCH_TUPLE: the elements of the pattern, and whether
+// the last is splatted (`...rest'), taking what is left of the tuple.
+#define MATCH_TUPLE(COUNT, SPLAT) ((COUNT) << 1 | (SPLAT))
+#define MATCH_COUNT(ARG) ((ARG) >> 1)
+#define MATCH_SPLAT(ARG) ((ARG) & 1)
+
+/// Elements of a tuple joined by OP_TUPLE_SPLAT: how many, and from
+/// where in the chunk's `splats' a flag for each says if it is splatted.
+typedef struct {
+	u32 count;
+	u32 splats;
+} TupleShape;
+
+/// Statically resolved location of a variable: the local `slot' of
+/// the context `depth' scopes above the innermost one.  The name is
+/// kept so the lookup can be checked, and for error messages.
+typedef struct {
+	u16 depth;
+	u16 slot;
+	Symbol name;
+} Address;
+
+#define ADDRESS_MAX 0xffff
+
+/// Types (a set of DataType bits) inferred for the operands of an
+/// arithmetic operation, which is unchecked when both are T_NUMBER.
+typedef struct {
+	const ParseNode *node;
+	u32 left;
+	u32 right;
+} TypeNote;
+
+#define ANY_TYPE 0xffffffffu
+
+/// Where a variable was last found, when the search started in a
+/// global (outermost) scope.  Reused until `binding_epoch' changes.
+/// Chunks of statements are run once, so only those of function
+/// bodies gain from it.
+typedef struct {
+	u64 epoch;
+	const struct _context *scope;  // Where the search started.
+	struct _local *local;
+} LoadCache;
+
+/// Compiled form of a parse tree.
+/// Constants point into the parse tree the chunk was compiled
+/// from, so a chunk must not outlive its tree.
+typedef struct _chunk {
+	array(Instr) code;
+	array(struct _datavalue *) constants;  // Immortal, not owned.
+	array(const ParseNode *) nodes;
+	array(struct _lambda *) lambdas;  // Templates, owned.
+	array(Address) addresses;
+	array(TupleShape) shapes;
+	array(bool) splats;
+	LoadCache *load_caches;  // One per address.
+	array(TypeNote) notes;  // Every arithmetic operation, in order.
+} Chunk;
+
+Chunk *compile(const ParseNode *, const ParseNode *);
+void free_chunk(Chunk *);
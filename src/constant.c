@@ -0,0 +1,120 @@
+#include "constant.h"
+
+DataValue SMALL_INTS[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+
+// Open addressing hash table of every other constant made so far.
+static struct {
+	usize len;
+	usize cap;  // Always a power of two.
+	DataValue **buf;
+} table = { 0 };
+
+void init_constants(void)
+{
+	for (ssize i = SMALL_INT_MIN; i <= SMALL_INT_MAX; ++i) {
+		DataValue *data = &SMALL_INTS[i - SMALL_INT_MIN];
+		data->refcount = IMMORTAL;
+		data->onstack = true;
+		data->type = T_NUMBER;
+		data->number = (NumberNode){ INT, { .i = i } };
+	}
+}
+
+static u64 hash_constant(const DataValue *data)
+{
+	u64 bits = 0;
+	if (data->type == T_STRING) {
+		bits = (uintptr_t)data->value;  // Strings are interned.
+	} else if (data->number.type == INT) {
+		bits = data->number.value.i;
+	} else {
+		f64 approx = data->number.value.f;
+		memcpy(&bits, &approx, sizeof(bits));
+	}
+	return (bits ^ data->type) * 11400714819323198485llu;
+}
+
+static bool same_constant(const DataValue *a, const DataValue *b)
+{
+	if (a->type != b->type)
+		return false;
+	if (a->type == T_STRING)
+		return a->value == b->value;
+	if (a->number.type != b->number.type)
+		return false;
+	if (a->number.type == INT)
+		return a->number.value.i == b->number.value.i;
+	return a->number.value.f == b->number.value.f
+		|| (isnan(a->number.value.f) && isnan(b->number.value.f));
+}
+
+static void rehash(usize cap)
+{
+	DataValue **buf = calloc(cap, sizeof(DataValue *));
+	for (usize i = 0; i < table.cap; ++i) {
+		DataValue *data = table.buf[i];
+		if (data == NULL) continue;
+		usize j = hash_constant(data) & (cap - 1);
+		while (buf[j] != NULL) j = (j + 1) & (cap - 1);
+		buf[j] = data;
+	}
+	free(table.buf);
+	table.buf = buf;
+	table.cap = cap;
+}
+
+/// Slot of the constant equal to `key', or the free slot for it.
+static usize probe(const DataValue *key)
+{
+	usize i = hash_constant(key) & (table.cap - 1);
+	while (table.buf[i] != NULL && !same_constant(table.buf[i], key))
+		i = (i + 1) & (table.cap - 1);
+	return i;
+}
+
+/// Find the constant equal to `key', making it if there is none yet.
+static DataValue *intern_constant(const DataValue *key)
+{
+	// Keep load below half.
+	if (2 * (table.len + 1) > table.cap)
+		rehash(table.cap == 0 ? 64 : 2 * table.cap);
+
+	usize i = probe(key);
+	if (table.buf[i] != NULL)
+		return table.buf[i];
+
+	DataValue *data = malloc(sizeof(DataValue));
+	*data = *key;
+	data->refcount = IMMORTAL;
+	data->onstack = true;  // Owns nothing.
+	table.buf[i] = data;
+	++table.len;
+	return data;
+}
+
+/// Borrowed, the constant may be linked like any value.
+DataValue *constant_number(NumberNode num)
+{
+	if (is_small_int(&num))
+		return &SMALL_INTS[num.value.i - SMALL_INT_MIN];
+	DataValue key = { .type = T_NUMBER, .number = num };
+	return intern_constant(&key);
+}
+
+DataValue *constant_string(StringNode str)
+{
+	DataValue key = { .type = T_STRING, .value = (void *)str.value };
+	return intern_constant(&key);
+}
+
+/// The constant equal to a number, without making one.
+/// NULL if the number was never a literal.
+const DataValue *find_constant_number(const NumberNode *num)
+{
+	if (is_small_int(num))
+		return &SMALL_INTS[num->value.i - SMALL_INT_MIN];
+	if (table.cap == 0)
+		return NULL;
+	DataValue key = { .type = T_NUMBER, .number = *num };
+	return table.buf[probe(&key)];
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "defaults.h"
+#include "execute.h"
+
+/// Constants are values made once and shared for the rest of the
+/// program: literals, and the integers around zero that computations
+/// produce most.  They are never freed, their reference count starts
+/// at IMMORTAL so it never reaches zero, nor looks like a single owner.
+#define IMMORTAL ((usize)1 << (sizeof(usize) * CHAR_BIT - 2))
+
+#define SMALL_INT_MIN (-1024)
+#define SMALL_INT_MAX 1024
+
+extern DataValue SMALL_INTS[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+
+static inline bool is_small_int(const NumberNode *num)
+{
+	return num->type == INT
+		&& num->value.i >= SMALL_INT_MIN
+		&& num->value.i <= SMALL_INT_MAX;
+}
+
+void init_constants(void);
+DataValue *constant_number(NumberNode);
+DataValue *constant_string(StringNode);
+const DataValue *find_constant_number(const NumberNode *);
@@ -39,6 +39,12 @@
 		newsize *= sizeof(type); \
 		(arr)->buf = realloc((arr)->buf, newsize); \
 	}
+#define push(type, arr, val) \
+	do { \
+		(arr)->len++; \
+		grow(type, arr); \
+		(arr)->buf[(arr)->len - 1] = (val); \
+	} while (0)
 
 extern const bool debug;
 
@@ -6,6 +6,7 @@
 #include "parse.h"
 #include "execute.h"
 #include "displays.h"
+#include "memo.h"
 
 char *display_nil(void)
 {
@@ -14,9 +15,15 @@ char *display_nil(void)
 
 char *display_lambda(Lambda *lambda)
 {
-	char *str = calloc(128, sizeof(char));
+	char *str = calloc(192, sizeof(char));
 	char *ptr = str;
-	ptr += sprintf(ptr, "<lambda %s", lambda->name);
+	ptr += sprintf(ptr, "<lambda %s", symbol_name(lambda->name));
+	if (lambda->memo != NULL) {
+		const Memo *memo = lambda->memo;
+		usize calls = memo->hits + memo->misses;
+		ptr += sprintf(ptr, " (memo: %zu/%zu hits, %.1f%%)", memo->hits, calls,
+			calls == 0 ? 0.0 : 100.0 * memo->hits / calls);
+	}
 	ptr += sprintf(ptr, " at %p>", (void *)lambda);
 	return str;
 }
@@ -71,6 +78,30 @@ char *display_datatype(DataType type)
 	}
 }
 
+/// A chain of (,) as (a , (b , (... , z))), written out in one go
+/// rather than nested, which would copy every tail of a long tuple.
+static char *display_tuple_tree(const ParseNode *tree)
+{
+	array(char *) elements;
+	init(elements, 8);
+	usize length = 1;
+	for (const ParseNode *rest = tree; rest != NULL;) {
+		char *element = display_parsetree(next_element(&rest));
+		push(char *, &elements, element);
+		length += strlen(element) + 5;  // "(" and " , " and ")".
+	}
+	char *string = malloc(sizeof(char) * length);
+	char *ptr = string;
+	for (usize i = 0; i < elements.len - 1; ++i)
+		ptr += sprintf(ptr, "(%s , ", elements.buf[i]);
+	ptr += sprintf(ptr, "%s", elements.buf[elements.len - 1]);
+	for (usize i = 0; i < elements.len - 1; ++i)
+		*ptr++ = ')';
+	*ptr = '\0';
+	free(elements.buf);
+	return string;
+}
+
 char *display_parsetree(const ParseNode *tree)
 {
 	static char unknown[256] = { '\0' };
@@ -78,14 +109,14 @@ char *display_parsetree(const ParseNode *tree)
 		return "NULL";
 	switch (tree->type) {
 	case IDENT_NODE: {
-		return tree->node.ident.value;
+		return (char *)symbol_name(tree->node.ident.symbol);
 	}
 	case NUMBER_NODE: {
 		return display_numbernode(tree->node.number);
 	}
 	case STRING_NODE: {  // TODO: Escape the string.
 		usize l = strlen((char *)tree->node.str.value);
-		char *str = malloc(l + 2);
+		char *str = malloc(l + 3);
 		str[0] = '"';
 		strcpy(str + 1, (char *)tree->node.str.value);
 		str[l + 1] = '"';
@@ -94,8 +125,10 @@ char *display_parsetree(const ParseNode *tree)
 	}
 	case UNARY_NODE: {
 		UnaryNode unary = tree->node.unary;
-		char *operand_str = display_parsetree(unary.operand);
-		char *callee_str  = display_parsetree(unary.callee);
+		char *operand_str = display_parsetree(unary_operand(tree));
+		const char *callee_str = unary.op == OPR_NONE
+			? display_parsetree(unary_callee(tree))
+			: operator_name(unary.op);
 
 		char *unary_str = malloc(sizeof(char) * (
 			+ strlen(operand_str)
@@ -109,9 +142,11 @@ char *display_parsetree(const ParseNode *tree)
 	}
 	case BINARY_NODE: {
 		BinaryNode binary = tree->node.binary;
-		char *left_str   = display_parsetree(binary.left);
-		char *right_str  = display_parsetree(binary.right);
-		char *callee_str = display_parsetree(binary.callee);
+		if (binary.op == OPR_COMMA)
+			return display_tuple_tree(tree);
+		char *left_str   = display_parsetree(binary_left(tree));
+		char *right_str  = display_parsetree(binary_right(tree));
+		const char *callee_str = operator_name(binary.op);
 
 		char *binary_str = malloc(sizeof(char) * (
 			+ strlen(left_str)
@@ -138,16 +173,12 @@ char *display_datavalue(const DataValue *data)
 	case T_NIL: {
 		return display_nil();
 	}
-	case T_NUMBER: {
-		if (data->value == NULL)
-			return strdup("number-with-null-value");
-		NumberNode *num = data->value;
-		return display_numbernode(*num);
-	}
+	case T_NUMBER:
+		return display_numbernode(data->number);
 	case T_STRING: {
 		char *inside = data->value;
 		usize len = strlen(inside);
-		string = malloc(len + 2);
+		string = malloc(len + 3);
 		strcpy(string + 1, inside);
 		string[0] = '"';
 		string[len + 1] = '"';
@@ -159,14 +190,15 @@ char *display_datavalue(const DataValue *data)
 	}
 	case T_TUPLE: {
 		Tuple *tuple = data->value;
-		usize cap = 128 * tuple->length; // guess.
+		usize cap = 128 * tuple->length + 3; // guess, room for "()".
 		usize totlen = 2; // '(' and ')'
 		string = calloc(cap, sizeof(char));
 		char *ptr = string;
 		ptr += sprintf(string, "(");
-		for (int i = tuple->length - 1; i >= 0; --i) {
-			DataValue *item = tuple->items[i];
+		for (usize i = 0; i < tuple->length; ++i) {
+			DataValue *item = tuple_item(tuple, i);
 			char *substr = display_datavalue(item);
+			unlink_datavalue(item);
 			totlen += strlen(substr);
 			totlen += 2; // ',' and ' '
 			if (totlen >= cap) {
@@ -175,7 +207,7 @@ char *display_datavalue(const DataValue *data)
 				string = realloc(string, sizeof(char) * cap);
 				ptr = string + offs;
 			}
-			if (i == 0) ptr += sprintf(ptr, "%s",   substr);
+			if (i == tuple->length - 1) ptr += sprintf(ptr, "%s",   substr);
 			else        ptr += sprintf(ptr, "%s, ", substr);
 			free(substr);
 		}
@@ -4,6 +4,11 @@
 #include "builtin.h"
 #include "prelude.h"
 #include "displays.h"
+#include "vm.h"
+#include "constant.h"
+#include "memo.h"
+#include "fold.h"
+#include "jit.h"
 
 #include <assert.h>
 #include <stddef.h>
@@ -13,17 +18,46 @@
 #include <string.h>
 
 static const f32 LOCALS_REALLOC_GROWTH_FACTOR = 1.5;
-static const fsize ZERO = 0.0;
+// Contexts with more locals than this look them up by hash.
+static const usize LOCALS_INDEX_THRESHOLD = 16;
 
 static const DataValue nil = { .type = T_NIL, .value = NULL };
 
-#define NUMERICAL_BINARY_OPERATION(DATA, OPERATION, LEFT, RIGHT) do { \
-	NumberNode *l_num = type_check(op, LHS, T_NUMBER, (LEFT));  \
-	NumberNode *r_num = type_check(op, RHS, T_NUMBER, (RIGHT)); \
-	if (l_num == NULL || r_num == NULL)    \
-		return NULL;                       \
-	(DATA) = heap_data(T_NUMBER, num_ ##OPERATION (*l_num, *r_num)); \
-} while (0);
+// Small objects are made and dropped constantly, so are pooled.
+u64 binding_epoch = 0;
+
+Pool datavalue_pool = POOL(DataValue);
+Pool context_pool = POOL(Context);
+Pool tuple_pool = POOL(Tuple);
+
+// Locals of contexts left in the reverse order they were made in
+// (calls, `let' and `where') are bump allocated on this stack, and
+// only moved to the heap if the context outlives its frame.
+#define FRAME_LOCALS_CAPACITY (1 << 20)
+#define FRAME_LOCALS_SLACK 4  // Room for a few more bindings.
+static struct {
+	Local *buf;
+	usize top;
+} frame_locals = { 0 };
+
+static void grow_locals(Context *);
+
+// Operators which act on numbers, indexed by operator.
+static const NumericOperation NUMERIC_OPERATIONS[OPERATOR_KINDS] = {
+	[OPR_ADD] = num_add,
+	[OPR_SUB] = num_sub,
+	[OPR_MUL] = num_mul,
+	[OPR_DIV] = num_div,
+	[OPR_CARET] = num_pow,
+	[OPR_STARSTAR] = num_pow,
+};
+
+// Natively implemented prefix/postfix operators, indexed by operator.
+static const FnPtr UNARY_OPERATIONS[OPERATOR_KINDS] = {
+	[OPR_NEG] = { builtin_neg },
+	[OPR_POS] = { builtin_pos },
+	[OPR_FACTORIAL] = { builtin_factorial },
+};
 
 inline
 DataValue *link_datavalue(DataValue *data)
@@ -49,26 +83,39 @@ void free_datavalue(DataValue *data)
 #if DEBUG
 		fprintf(stderr, "freeing data(stack: %d): %s    \033[2m(%p)\033[0m\n", data->onstack, display_datavalue(data), data->value);
 #endif
-	// Aggregate types must unlink children when freed.
-	if (data->type == T_TUPLE) {
+	if (data->type == T_LAMBDA) {
+		free_lambda(data->value);
+	} else if (data->type == T_TUPLE) {
+		// Aggregate types must unlink children when freed.
 		Tuple *tup = data->value;
-		for (usize i = 0; i < tup->length; ++i)
-			unlink_datavalue(tup->items[i]);
-	}
-	if (!data->onstack)
+		if (tup->kind == TUPLE_RANGE) {
+			// Nothing to free, its items are computed.
+		} else if (tup->base != NULL) {
+			unlink_datavalue(tup->base);  // Slices only share the items.
+		} else {
+			if (tup->kind == TUPLE_ITEMS)
+				for (usize i = 0; i < tup->length; ++i)
+					unlink_datavalue(tup->items[i]);
+			free(tup->items);  // Whichever kind of items.
+		}
+		pool_free(&tuple_pool, tup);
+	} else if (!data->onstack && data->type != T_NUMBER) {
 		free(data->value);
-	free(data);  // data-wrapper itself is always malloc'd.
+	}
+	pool_free(&datavalue_pool, data);  // data-wrapper itself is always pooled.
 }
 
 void free_context(Context *ctx)
 {
 #if DEBUG
-		fprintf(stderr, "destroying context: %s:\n", ctx->function);
+		fprintf(stderr, "destroying context: %s:\n", symbol_name(ctx->function));
 #endif
 	// If this context is getting free'd,
 	// the superior context has one fewer references.
 	if (ctx->superior != NULL)
 		unlink_context(ctx->superior);
+	else
+		forget_constants(ctx);
 	// Unlink all references from locals.
 	for (usize i = 0; i < ctx->locals_count; ++i) {
 #if DEBUG
@@ -77,8 +124,10 @@ void free_context(Context *ctx)
 		unlink_datavalue(ctx->locals[i].value);
 	}
 	// Free dynamic array of locals.
-	free(ctx->locals);
-	free(ctx);
+	if (!ctx->locals_on_stack)
+		free(ctx->locals);
+	free(ctx->index);
+	pool_free(&context_pool, ctx);
 }
 
 inline
@@ -93,28 +142,45 @@ Context *link_context(Context *ctx)
 void unlink_context(Context *ctx)
 {
 #if DEBUG
-	fprintf(stderr, "unlinking context `%s`; ref count = %lu\n", ctx->function, ctx->refcount - 1);
+	fprintf(stderr, "unlinking context `%s`; ref count = %lu\n", symbol_name(ctx->function), ctx->refcount - 1);
 #endif
 	if (--ctx->refcount == 0) free_context(ctx);
 }
 
 static DataValue *recursive_execute(Context *ctx, const ParseNode *stmt);
 
+static void bind_answer(Context *ctx, DataValue *data)
+{
+	// When line/statement is finished evaluating, bind `Ans'.
+	if (data != NULL && ERROR_TYPE == NO_ERROR) {
+		bind_local(ctx, SYM_Ans, data);
+		bind_local(ctx, SYM_ans, data);
+		bind_local(ctx,   SYM__, data);
+	}
+}
+
 /// Takes in an execution context (ctx) and a
 /// statement as produced by the parser (stmt).
 /// Returns what it evaluates to.
 DataValue *execute(Context *ctx, const ParseNode *stmt)
 {
-	// Recurse dowm parse tree, execute each node, bottom up.
-	DataValue *data = recursive_execute(ctx, stmt);
+	// Lower the statement to bytecode, and run it.
+	Chunk *chunk = compile(stmt, NULL);
+	DataValue *data = run_chunk(ctx, chunk);
+	free_chunk(chunk);
 
-	// When line/statement is finished evaluating, bind `Ans'.
-	if (data != NULL && ERROR_TYPE == NO_ERROR) {
-		bind_local(ctx, "Ans", data);
-		bind_local(ctx, "ans", data);
-		bind_local(ctx,   "_", data);
-	}
+	bind_answer(ctx, data);
+	return data;
+}
 
+/// Same as `execute', but evaluates by walking the parse tree
+/// directly instead of compiling it.  This is the reference
+/// evaluator, which the bytecode VM is benchmarked against.
+DataValue *execute_tree(Context *ctx, const ParseNode *stmt)
+{
+	// Recurse dowm parse tree, execute each node, bottom up.
+	DataValue *data = recursive_execute(ctx, stmt);
+	bind_answer(ctx, data);
 	return data;
 }
 
@@ -129,137 +195,105 @@ static DataValue *recursive_execute(Context *ctx, const ParseNode *stmt)
 		// are no more superior scopes, if the local is
 		// found yield its corresponding value, or else
 		// throw an execution error.
-		char *ident_name = stmt->node.ident.value;
-		Local *local = search_locals(ctx, ident_name);
+		Symbol name = stmt->node.ident.symbol;
+		Local *local = search_locals(ctx, name);
 		if (local != NULL) {
-			free(data);
+			pool_free(&datavalue_pool, data);
 			data = link_datavalue(local->value);  // another reference.
 		} else {
 			ERROR_TYPE = EXECUTION_ERROR;
 			sprintf(ERROR_MSG, "Could not find variable `%s'\n"
-				"  in any local or superior scope.", ident_name);
+				"  in any local or superior scope.", symbol_name(name));
 			return NULL;
 		}
 		break;
 	}
 	case NUMBER_NODE: {
-		NumberNode *new_num = malloc(sizeof(NumberNode));
-		memcpy(new_num, &stmt->node.number, sizeof(NumberNode));
-		free(data);
-		data = heap_data(T_NUMBER, new_num);
+		pool_free(&datavalue_pool, data);
+		data = link_datavalue(constant_number(stmt->node.number));
 		break;
 	}
 	case STRING_NODE: {
-		char *string = malloc(stmt->node.str.len + 1);
-		memcpy(string, stmt->node.str.value, stmt->node.str.len + 1);
-		free(data);
-		data = heap_data(T_STRING, string);
+		pool_free(&datavalue_pool, data);
+		data = link_datavalue(constant_string(stmt->node.str));
 		break;
 	}
 	case UNARY_NODE: { // Functions, essentially.
-		DataValue *callee  = recursive_execute(ctx, stmt->node.unary.callee);
-		DataValue *operand = recursive_execute(ctx, stmt->node.unary.operand);
+		if (stmt->node.unary.op != OPR_NONE) {
+			// Prefix and postfix operators.
+			pool_free(&datavalue_pool, data);
+			DataValue *operand = recursive_execute(ctx, unary_operand(stmt));
+			if (operand == NULL) return NULL;
+			data = unary_operation(stmt->node.unary.op, operand);
+			unlink_datavalue(operand);
+			break;
+		}
+
+		DataValue *callee  = recursive_execute(ctx, unary_callee(stmt));
+		DataValue *operand = recursive_execute(ctx, unary_operand(stmt));
 
 
 		if (callee == NULL || operand == NULL) {
 			if (callee != NULL) unlink_datavalue(callee);
 			if (operand != NULL) unlink_datavalue(operand);
-			free(data);
+			pool_free(&datavalue_pool, data);
 			return NULL;
 		}
 
-		// Juxtaposition of numbers, implies multiplication.
-		if (callee->type == T_NUMBER && operand->type == T_NUMBER) {
-			NumberNode *new_num = num_mul(*(NumberNode *)callee->value,
-				*(NumberNode *)operand->value);
-			free(data);
-			data = heap_data(T_NUMBER, new_num);
+		// Numbers, tuples and native functions are applied directly.
+		if (callee->type != T_LAMBDA) {
+			pool_free(&datavalue_pool, data);
+			data = apply_primitive(callee, operand);
 			goto unary_discard;
 		}
 
-		// Tuples are essentially functions from the set of indices {1,...,N}
-		// to the value at that index.
-		if (callee->type == T_TUPLE && operand->type == T_NUMBER) {
-			Tuple *tup = callee->value;
-			NumberNode *idx = operand->value;
-			if (idx->type != INT) {
-				ERROR_TYPE = TYPE_ERROR;
-				strcpy(ERROR_MSG, "Can only index tuple with integer.");
-				return NULL;
+		Lambda *lambda = callee->value;
+		if (lambda->memo != NULL) {
+			DataValue *remembered = memo_lookup(lambda->memo, operand);
+			if (remembered != NULL) {
+				pool_free(&datavalue_pool, data);
+				data = link_datavalue(remembered);
+				goto unary_discard;
 			}
-			ssize n = idx->value.i;
-			usize len = tup->length;
-			if (n > (ssize)len || n == 0) {
-				ERROR_TYPE = EXECUTION_ERROR;
-				sprintf(ERROR_MSG, "Index %ld out of range for tuple of length %lu.", n, len);
-				return NULL;
+		}
+		if (may_run_native(lambda)) {
+			DataValue *result = call_native(lambda, operand);
+			if (result != NULL) {
+				pool_free(&datavalue_pool, data);
+				data = result;
+				goto remember;
 			}
-			if (n < 0) n = len + n + 1;
-			if (n < 0 || n > (ssize)len || n == 0) {
-				// Still negative, means index was out of range.
-				ERROR_TYPE = EXECUTION_ERROR;
-				sprintf(ERROR_MSG, "Index %ld out of range for tuple of length %lu.", n, len);
-				return NULL;
+		}
+		// Make the function call frame / local execution context.
+		Context *local_ctx = push_context(lambda->name, lambda->scope,
+			frame_size(lambda));
+		const LambdaPattern *lampat = match_lambda(local_ctx, lambda, operand);
+		bool did_match = lampat != NULL;
+		if (did_match) {
+			// Evaluate body, and finish.
+			pool_free(&datavalue_pool, data);
+			switch (lampat->body_type) {
+				case ParseNodeBody: {
+					data = recursive_execute(local_ctx, lampat->body);
+				} break;
+				case LambdaBody: {
+					Lambda *nested_lambda = copy_lambda(lampat->lambda, local_ctx);
+					data = heap_data(T_LAMBDA, nested_lambda);
+				} break;
 			}
-			// tuples are 1-indexed.
-			usize i = n - 1;
-			DataValue *val = tup->items[len - i - 1];
-			free(data);
-			// Copy the contained value.
-			data = copy_data(val);
-			goto unary_discard;
 		}
-
-		// Otherwise, we expect a lambda or function pointer as callee.
-		void *func = type_check("function", ARG, T_LAMBDA | T_FUNCTION_PTR, callee);
-		if (func == NULL) {
-			free(data);
+		// Temporary execution context spent.
+		pop_context(local_ctx);
+		if (!did_match) {
+			// Never matched.
+			ERROR_TYPE = EXECUTION_ERROR;
+			strcpy(ERROR_MSG, "No branch of the function matched against this argument.");
+			pool_free(&datavalue_pool, data);
 			data = NULL;
-			goto unary_discard;
-		}
-
-		if (callee->type == T_FUNCTION_PTR) {
-			FUNC_PTR(fn) = ((FnPtr *)func)->fn;
-			free(data);
-			data = fn(*operand);
-		} else if (callee->type == T_LAMBDA) {
-			Lambda *lambda = func;
-			// Make the function call frame / local execution context.
-			Context *local_ctx = make_context(lambda->name, lambda->scope);
-			bool did_match = false;
-			for (usize i = 0; i < lambda->patterns.len; ++i) {
-				// Go through patterns, attempting to match them.
-				LambdaPattern *lampat = &lambda->patterns.buf[i];
-				did_match = match_local(local_ctx, lampat->pattern, operand);
-				if (did_match) {
-					// Evaluate body, and finish.
-					free(data);
-					switch (lampat->body_type) {
-						case ParseNodeBody: {
-							data = recursive_execute(local_ctx, lampat->body);
-						} break;
-						case LambdaBody: {
-							Lambda *nested_lambda = malloc(sizeof(Lambda));
-							*nested_lambda = *lampat->lambda; // Shallow copy.
-							nested_lambda->scope = link_context(local_ctx);
-							data = heap_data(T_LAMBDA, nested_lambda);
-						} break;
-					}
-					break;
-				}
-			}
-			if (!did_match) {
-				// Never matched.
-				ERROR_TYPE = EXECUTION_ERROR;
-				strcpy(ERROR_MSG, "No branch of the function matched against this argument.");
-				return NULL;
-			}
-			// Temporary execution context spent.
-			unlink_context(local_ctx);
-		} else {
-			fprintf(stderr, "prelimary type check failed to catch wrong function callee.\n");
-			exit(2);
 		}
+remember:
+		if (data != NULL && lambda->memo != NULL)
+			memo_store(lambda->memo, operand, data);
 
 unary_discard:
 		// Operation operator and operand are discarded after result produced.
@@ -268,26 +302,19 @@ unary_discard:
 		break;
 	}
 	case BINARY_NODE: {
-		IdentNode ident = stmt->node.binary.callee->node.ident;
-		if (stmt->node.binary.callee->type != IDENT_NODE) {
-			ERROR_TYPE = EXECUTION_ERROR;
-			strcpy(ERROR_MSG, "Binary operation has non-ident callee.");
-			return NULL;
-		}
-
-		// Variables in case of function definition.
-		char *func_name = NULL;
-		const ParseNode *func_operand = NULL;
-		const ParseNode *func_body = NULL;
+		const BinaryNode *binary = &stmt->node.binary;
+		const ParseNode *left = binary_left(stmt);
+		const ParseNode *right = binary_right(stmt);
+		pool_free(&datavalue_pool, data);
+		data = NULL;
 
-		char *op = ident.value;
+		switch (binary->op) {
 		// Equality is special:
-		if (strcmp(op, "=") == 0) {
-			if (stmt->node.binary.left->type == UNARY_NODE) {
-				const ParseNode *func_call = stmt->node.binary.left;
-				func_body = stmt->node.binary.right;
-				Lambda *lam = register_lambda_pattern(ctx, func_call, func_body);
-				free(data);
+		case OPR_ASSIGN: {
+			if (is_application(left)) {
+				const ParseNode *func_call = left;
+				Lambda *lam = register_lambda_pattern(ctx, func_call, right);
+				if (lam == NULL) return NULL;
 				Local *found = search_locals(ctx, lam->name);
 				if (found == NULL) {
 					// Bind the lambda in this scope if it does not exist yet.
@@ -297,229 +324,123 @@ unary_discard:
 					// Othwise, just return a reference to the lambda.
 					data = link_datavalue(found->value);
 				}
-				break;
 			} else {
-				const ParseNode *lvalue = stmt->node.binary.left;
-				const ParseNode *rvalue = stmt->node.binary.right;
-				free(data);
-				data = recursive_execute(ctx, rvalue);
+				data = recursive_execute(ctx, right);
 				if (data == NULL) return NULL;
-				if (!match_local(ctx, lvalue, data)) {
+				if (!match_local(ctx, left, data)) {
 					ERROR_TYPE = EXECUTION_ERROR;
 					strcpy(ERROR_MSG, "Mismatched left hand side of expression.");
 					return NULL;
 				}
-				break;
 			}
-		} else if (strcmp(op, "->") == 0) {  // Lambda expression.
-			func_name = "<anon>";
-			func_operand = stmt->node.binary.left;
-			func_body = stmt->node.binary.right;
-			Lambda *lam = make_lambda(ctx, func_name, func_operand, func_body);
-			free(data);
+			break;
+		}
+		case OPR_ARROW: {  // Lambda expression.
+			Lambda *lam = make_lambda(ctx, SYM_ANON, left, right);
 			data = heap_data(T_LAMBDA, lam);
 			break;
 		}
-
 		// `let ... in ...` operator.
-		if (strcmp(op, "let-in") == 0) {
+		case OPR_LET_IN: {
 			// Evaluate left first (in its own scope), then right.
 			// Discard left, return right.
-			Context *sub = make_context("<let-clause>", ctx);
-			DataValue *lhs = recursive_execute(sub, stmt->node.binary.left);
+			Context *sub = push_context(SYM_LET_CLAUSE, ctx, 0);
+			DataValue *lhs = recursive_execute(sub, left);
 			// Evaluated LHS bindings, execute RHS in new context `delta`.
-			Context *delta = make_context("<let-expr>", sub);
-			DataValue *rhs = recursive_execute(delta, stmt->node.binary.right);
+			Context *delta = push_context(SYM_LET_EXPR, sub, 0);
+			DataValue *rhs = recursive_execute(delta, right);
 			// Use bindings made in `delta` to update current `ctx`.
-			for (usize i = 0; i < delta->locals_count; ++i) {
-				Local local = delta->locals[i];
-				bind_local(ctx, local.name, local.value);
-			}
+			export_locals(delta, ctx);
 			// Finished with `delta` scope.
-			unlink_context(delta);
+			pop_context(delta);
 			// Discard LHS after computing RHS.
 			unlink_datavalue(lhs);
-			unlink_context(sub);
+			pop_context(sub);
 			// Return RHS.
-			free(data);
 			data = link_datavalue(rhs);
 			unlink_datavalue(rhs);
 			break;
 		}
-
 		// `where` operator.
-		if (strcmp(op, "where") == 0) {
+		case OPR_WHERE: {
 			// Evaluate right first (in its own scope), then left.
 			// Discard right, return left.
-			Context *sub = make_context("<where-clause>", ctx);
-			DataValue *rhs = recursive_execute(sub, stmt->node.binary.right);
+			Context *sub = push_context(SYM_WHERE_CLAUSE, ctx, 0);
+			DataValue *rhs = recursive_execute(sub, right);
 			// Evaluated RHS bindings, execute LHS in new context `delta`.
-			Context *delta = make_context("<where-expr>", sub);
-			DataValue *lhs = recursive_execute(delta, stmt->node.binary.left);
+			Context *delta = push_context(SYM_WHERE_EXPR, sub, 0);
+			DataValue *lhs = recursive_execute(delta, left);
 			// Use bindings made in `delta` to update current `ctx`.
-			for (usize i = 0; i < delta->locals_count; ++i) {
-				Local local = delta->locals[i];
-				bind_local(ctx, local.name, local.value);
-			}
+			export_locals(delta, ctx);
 			// Finished with `delta` scope.
-			unlink_context(delta);
+			pop_context(delta);
 			// Discard RHS after computing LHS.
 			unlink_datavalue(rhs);
-			unlink_context(sub);
+			pop_context(sub);
 			// Return LHS.
-			free(data);
 			data = link_datavalue(lhs);
 			unlink_datavalue(lhs);
 			break;
 		}
-
 		// Tuples
-		if (strcmp(op, ",") == 0) {
-			const ParseNode *head = stmt->node.binary.left;
-			const ParseNode *tail = stmt->node.binary.right;
-
-			const ParseNode *splatted = NULL;
-			// Handle splat `...` syntax.
-			if (head->type == UNARY_NODE) {
-				const ParseNode *splat = head->node.unary.callee;
-				if (splat->type == IDENT_NODE && strcmp(splat->node.ident.value, "...") == 0) {
-					splatted = head->node.unary.operand;
-				}
-			}
-
-			DataValue *lhs = NULL;
-			if (splatted != NULL) {
-				lhs = recursive_execute(ctx, splatted);
-				if (lhs->type != T_TUPLE) {
-					ERROR_TYPE = EXECUTION_ERROR;
-					strcpy(ERROR_MSG, "Cannot splat non-tuple.");
-					lhs = NULL;
-				}
-			} else {
-				lhs = recursive_execute(ctx, head);
+		case OPR_COMMA: {
+			// Evaluate every element, then join them at once.
+			usize count = tuple_elements(stmt);
+			DataValue *few[16];
+			bool few_splats[16] = { 0 };
+			DataValue **values = count <= len(few)
+				? few : malloc(sizeof(DataValue *) * count);
+			bool *splats = count <= len(few_splats)
+				? few_splats : malloc(sizeof(bool) * count);
+			const ParseNode *rest = stmt;
+			usize done = 0;
+			for (; done < count; ++done) {
+				const ParseNode *element = next_element(&rest);
+				splats[done] = is_operation(element, OPR_SPLAT);
+				if (splats[done])
+					element = unary_operand(element);
+				values[done] = recursive_execute(ctx, element);
+				if (values[done] == NULL)
+					break;
 			}
-			if (lhs == NULL) return NULL;
-			DataValue *rhs = NULL;
-			if (tail->type == UNARY_NODE) {
-				const ParseNode *splat = tail->node.unary.callee;
-				if (splat->type == IDENT_NODE && strcmp(splat->node.ident.value, "...") == 0) {
-					rhs = recursive_execute(ctx, tail->node.unary.operand);
-					if (rhs->type != T_TUPLE) {
-						ERROR_TYPE = EXECUTION_ERROR;
-						strcpy(ERROR_MSG, "Cannot splat non-tuple.");
-						rhs = NULL;
-					}
-				}
-			} else {
-				rhs = recursive_execute(ctx, tail);
+			if (done == count)
+				data = join_tuple(values, count, splats);
+			for (usize i = 0; i < done; ++i)
+				unlink_datavalue(values[i]);
+			if (values != few)
+				free(values);
+			if (splats != few_splats)
+				free(splats);
+			break;
+		}
+		default: {
+			// How to evaluate specific operators.
+			DataValue *lhs = recursive_execute(ctx, left);
+			if (lhs == NULL) {
+				return NULL;
 			}
+			DataValue *rhs = recursive_execute(ctx, right);
 			if (rhs == NULL) {
 				unlink_datavalue(lhs);
 				return NULL;
 			}
 
-			if (rhs->type != T_TUPLE) {
-				// Create new tuple.
-				Tuple *tuple = malloc(sizeof(Tuple));
-				tuple->length = 2;
-				tuple->capacity = 2;
-				if (splatted != NULL) {
-					Tuple *lhs_tup = lhs->value;
-					tuple->length = lhs_tup->length + 1;
-					tuple->capacity = tuple->length;
-				}
-				tuple->items = calloc(tuple->capacity, sizeof(DataValue *));
-				tuple->items[0] = link_datavalue(rhs);
-				if (splatted != NULL) {
-					// Copy over the splatted values.
-					Tuple *lhs_tup = lhs->value;
-					for (usize i = 0; i < lhs_tup->length; ++i) {
-						tuple->items[i + 1] = link_datavalue(lhs_tup->items[i]);
-					}
-				} else {
-					tuple->items[1] = link_datavalue(lhs);
-				}
-				free(data);
-				data = heap_data(T_TUPLE, tuple);
-				unlink_datavalue(lhs);
-				unlink_datavalue(rhs);
-				break;
-			}
-
-			// RHS is a tuple, clone it and extend it.
-			Tuple *rhs_tup = rhs->value;
-			Tuple *tuple = malloc(sizeof(Tuple));
-			tuple->length = rhs_tup->length + 1;
-			if (splatted != NULL) {
-				Tuple *lhs_tup = lhs->value;
-				tuple->length = lhs_tup->length + rhs_tup->length;
-			}
-			tuple->capacity = tuple->length;
-			tuple->items = calloc(tuple->capacity, sizeof(DataValue *));
-			// Copy old values;
-			for (usize i = 0; i < rhs_tup->length; ++i)
-				tuple->items[i] = link_datavalue(rhs_tup->items[i]);
-			// Grow capacity.
-			if (tuple->length >= tuple->capacity) {
-				tuple->capacity = 1.5 * tuple->length + 1;
-				tuple->items = realloc(tuple->items, tuple->capacity * sizeof(DataValue *));
-			}
-			if (splatted != NULL) {
-				Tuple *lhs_tup = lhs->value;
-				for (usize i = 0; i < lhs_tup->length; ++i) {
-					tuple->items[rhs_tup->length + i] = link_datavalue(lhs_tup->items[i]);
-				}
+			if (binary->op == OPR_SEMICOLON) {
+				// Evaluate the left, then the right.
+				// Discard the left, return the right.
+				data = link_datavalue(rhs);
+			} else if (binary->op == OPR_RANGE) {
+				data = make_range(lhs, rhs);
 			} else {
-				tuple->items[rhs_tup->length] = link_datavalue(lhs);
+				// Numerical binary operations.
+				data = binary_operation(binary->op, lhs, rhs);
 			}
-			free(data);
-			data = heap_data(T_TUPLE, tuple);
+			// Operation operands are discarded.
 			unlink_datavalue(lhs);
 			unlink_datavalue(rhs);
 			break;
 		}
-
-		free(data);
-		// How to evaluate specific operators.
-		DataValue *lhs = recursive_execute(ctx, stmt->node.binary.left);
-		if (lhs == NULL) {
-			return NULL;
-		}
-		DataValue *rhs = recursive_execute(ctx, stmt->node.binary.right);
-		if (rhs == NULL) {
-			unlink_datavalue(lhs);
-			return NULL;
-		}
-
-		// Semicolons
-		if (strcmp(op, ";") == 0) {
-			// Evaluate the left, then the right.
-			// Discard the left, return the right.
-			data = link_datavalue(rhs);
-			goto binary_discard;
-		}
-
-		// Numerical binary operations.
-		if (strcmp(op, "+") == 0) {
-			NUMERICAL_BINARY_OPERATION(data, add, lhs, rhs);
-		} else if (strcmp(op, "-") == 0) {
-			NUMERICAL_BINARY_OPERATION(data, sub, lhs, rhs);
-		} else if (strcmp(op, "*") == 0) {
-			NUMERICAL_BINARY_OPERATION(data, mul, lhs, rhs);
-		} else if (strcmp(op, "/") == 0) {
-			NUMERICAL_BINARY_OPERATION(data, div, lhs, rhs);
-		} else if (strcmp(op, "^") * strcmp(op, "**") == 0) {
-			NUMERICAL_BINARY_OPERATION(data, pow, lhs, rhs);
-		} else {
-			ERROR_TYPE = EXECUTION_ERROR;
-			sprintf(ERROR_MSG, "Do not know how to evaluate"
-				" use of `%s' operator.", op);
-			data = NULL;
 		}
-		// Operation operands are discarded.
-binary_discard:
-		unlink_datavalue(lhs);
-		unlink_datavalue(rhs);
 		break;
 	}
 	default: {
@@ -536,7 +457,7 @@ binary_discard:
 
 DataValue *wrap_data(DataType type, void *value, bool onstack)
 {
-	DataValue *data = malloc(sizeof(DataValue));
+	DataValue *data = pool_alloc(&datavalue_pool);
 	data->refcount = 1;
 	data->type = type;
 	data->value = value;
@@ -550,13 +471,684 @@ DataValue *stack_data(DataType type, void *value)
 DataValue *heap_data(DataType type, void *value)
 { return wrap_data(type, value, false); }
 
+/// Numbers are carried in the wrapper itself.
+/// Small integers are shared constants instead.
+DataValue *number_data(NumberNode num)
+{
+	if (is_small_int(&num))
+		return link_datavalue(&SMALL_INTS[num.value.i - SMALL_INT_MIN]);
+	DataValue *data = pool_alloc(&datavalue_pool);
+	data->refcount = 1;
+	data->type = T_NUMBER;
+	data->number = num;
+	data->onstack = false;
+	return data;
+}
+
+/// Wrap a numeric result.  An operand only the caller refers to is
+/// about to be discarded anyway, so it holds the result instead.
+static DataValue *number_result(NumberNode num, DataValue *lhs, DataValue *rhs)
+{
+	DataValue *target = NULL;
+	if (lhs->refcount == 1)
+		target = lhs;
+	else if (rhs->refcount == 1)
+		target = rhs;
+	if (target == NULL)
+		return number_data(num);
+	target->number = num;
+	return link_datavalue(target);
+}
+
+DataValue *numeric_operation(const char *op, NumericOperation operation,
+	DataValue *lhs, DataValue *rhs)
+{
+	NumberNode *l_num = type_check(op, LHS, T_NUMBER, lhs);
+	NumberNode *r_num = type_check(op, RHS, T_NUMBER, rhs);
+	if (l_num == NULL || r_num == NULL)
+		return NULL;
+	NumberNode result;
+	if (!operation(l_num, r_num, &result))
+		return NULL;
+	return number_result(result, lhs, rhs);
+}
+
+/// Same as `numeric_operation', for operands known to be numbers.
+DataValue *unchecked_operation(NumericOperation operation,
+	DataValue *lhs, DataValue *rhs)
+{
+	// The compiler got it wrong if not.
+	assert(lhs->type == T_NUMBER && rhs->type == T_NUMBER);
+	NumberNode result;
+	if (!operation(&lhs->number, &rhs->number, &result))
+		return NULL;
+	return number_result(result, lhs, rhs);
+}
+
+
+static DataValue *tuple_operation(OperatorKind, DataValue *, DataValue *);
+
+/// Evaluate a binary operator on two values.
+/// Neither of the operands are unlinked, though one the caller holds
+/// the only reference to may be reused for the result.
+DataValue *binary_operation(OperatorKind op, DataValue *lhs, DataValue *rhs)
+{
+	NumericOperation operation = NUMERIC_OPERATIONS[op];
+	if (operation == NULL) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Do not know how to evaluate"
+			" use of `%s' operator.", operator_name(op));
+		return NULL;
+	}
+	if (lhs->type == T_TUPLE || rhs->type == T_TUPLE)
+		return tuple_operation(op, lhs, rhs);
+	// The name of the operator is only looked up to report an error.
+	if (lhs->type != T_NUMBER || rhs->type != T_NUMBER)
+		return numeric_operation(operator_name(op), operation, lhs, rhs);
+	return unchecked_operation(operation, lhs, rhs);
+}
+
+/// Evaluate a prefix or postfix operator on a value.
+/// The operand is not unlinked.
+DataValue *unary_operation(OperatorKind op, DataValue *operand)
+{
+	if (op == OPR_SPLAT) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		strcpy(ERROR_MSG, "Splat `...' may only be used inside a tuple.");
+		return NULL;
+	}
+	FUNC_PTR(fn) = UNARY_OPERATIONS[op].fn;
+	if (fn == NULL) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Do not know how to evaluate"
+			" use of `%s' operator.", operator_name(op));
+		return NULL;
+	}
+	return fn(*operand);
+}
+
+/// Position in a tuple of an index, counting from 1, or from -1 at the
+/// end backwards.  False (with an error) if it is out of range.
+static bool tuple_index(const Tuple *tup, const NumberNode *idx, usize *position)
+{
+	if (idx->type != INT) {
+		ERROR_TYPE = TYPE_ERROR;
+		strcpy(ERROR_MSG, "Can only index tuple with integer.");
+		return false;
+	}
+	ssize n = idx->value.i;
+	usize len = tup->length;
+	if (n > (ssize)len || n == 0) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Index %ld out of range for tuple of length %lu.", n, len);
+		return false;
+	}
+	if (n < 0) n = len + n + 1;
+	if (n < 0 || n > (ssize)len || n == 0) {
+		// Still negative, means index was out of range.
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Index %ld out of range for tuple of length %lu.", n, len);
+		return false;
+	}
+	// tuples are 1-indexed.
+	*position = n - 1;
+	return true;
+}
+
+static DataValue *range_tuple(ssize, ssize, usize);
+static void copy_items(Tuple *, usize, const Tuple *, usize, usize);
+
+/// The items of a tuple at each of the indices.  Evenly spaced indices,
+/// as from a range, give a slice of the tuple, or a range of a range,
+/// without copying.  Other indices gather the items into a new tuple.
+static DataValue *index_tuple(DataValue *tuple, const Tuple *indices)
+{
+	const Tuple *tup = tuple->value;
+	usize count = indices->length;
+	usize first = 0;
+	ssize stride = 1;
+	bool spaced = true;  // Each position is first + i*stride.
+	bool checked = false;
+	if (indices->kind == TUPLE_RANGE && count > 0) {
+		// Only the ends of a range need checking when both count from
+		// the same end, the positions between then follow the indices.
+		NumberNode lo = { INT, { .i = indices->range.start } };
+		NumberNode hi = { INT, { .i = indices->range.start
+			+ (ssize)(count - 1) * indices->range.step } };
+		usize last;
+		if (!tuple_index(tup, &lo, &first) || !tuple_index(tup, &hi, &last))
+			return NULL;
+		stride = indices->range.step;
+		checked = (lo.value.i < 0) == (hi.value.i < 0);
+	}
+	for (usize i = 0; i < count && !checked; ++i) {
+		usize position;
+		DataValue *index = tuple_item(indices, i);
+		bool valid = index->type == T_NUMBER
+			&& tuple_index(tup, &index->number, &position);
+		unlink_datavalue(index);
+		if (!valid) {
+			if (ERROR_TYPE == NO_ERROR) {
+				ERROR_TYPE = TYPE_ERROR;
+				strcpy(ERROR_MSG, "Can only index tuple with integer.");
+			}
+			return NULL;
+		}
+		if (i == 0)
+			first = position;
+		else if (i == 1)
+			stride = (ssize)position - (ssize)first;
+		else if ((ssize)position != (ssize)first + (ssize)i * stride)
+			spaced = false;
+	}
+	if (spaced && tup->kind == TUPLE_RANGE)
+		return range_tuple(tup->range.start + (ssize)first * tup->range.step,
+			tup->range.step * stride, count);
+	if (spaced && stride == 1)
+		return slice_tuple(tuple, first, count);
+
+	DataValue *result = alloc_tuple(tup->kind == TUPLE_RANGE
+		? TUPLE_INTS : tup->kind, count);
+	Tuple *gathered = result->value;
+	for (usize i = 0; i < count; ++i) {
+		usize position;
+		DataValue *index = tuple_item(indices, i);
+		tuple_index(tup, &index->number, &position);
+		unlink_datavalue(index);
+		copy_items(gathered, i, tup, position, 1);
+	}
+	return result;
+}
+
+/// Apply a callee which is not a lambda to an operand.
+/// Neither the callee nor the operand are unlinked (see `binary_operation').
+DataValue *apply_primitive(DataValue *callee, DataValue *operand)
+{
+	// Juxtaposition of numbers, implies multiplication.
+	if (callee->type == T_NUMBER && operand->type == T_NUMBER) {
+		NumberNode product;
+		if (!num_mul(&callee->number, &operand->number, &product))
+			return NULL;
+		return number_result(product, callee, operand);
+	}
+
+	// Tuples are essentially functions from the set of indices {1,...,N}
+	// to the value at that index.
+	if (callee->type == T_TUPLE && operand->type == T_NUMBER) {
+		usize i;
+		if (!tuple_index(callee->value, &operand->number, &i))
+			return NULL;
+		// Values are immutable, so the item itself can be shared,
+		// and items of ranges are computed, never stored.
+		return tuple_item(callee->value, i);
+	}
+	// Indexing by a tuple of indices, such as a range (a:b).
+	if (callee->type == T_TUPLE && operand->type == T_TUPLE)
+		return index_tuple(callee, operand->value);
+
+	// Otherwise, we expect a function pointer as callee.
+	void *func = type_check("function", ARG, T_LAMBDA | T_FUNCTION_PTR, callee);
+	if (func == NULL)
+		return NULL;
+
+	if (callee->type != T_FUNCTION_PTR) {
+		fprintf(stderr, "prelimary type check failed to catch wrong function callee.\n");
+		exit(2);
+	}
+	FUNC_PTR(fn) = ((FnPtr *)func)->fn;
+	return fn(*operand);
+}
+
+/// Bytes taken by each item of a kind of tuple.
+static inline usize item_size(TupleKind kind)
+{
+	switch (kind) {
+	case TUPLE_INTS:   return sizeof(ssize);
+	case TUPLE_FLOATS: return sizeof(fsize);
+	default:           return sizeof(DataValue *);
+	}
+}
+
+/// A tuple with room for `length' items of a kind, to be filled in.
+DataValue *alloc_tuple(TupleKind kind, usize length)
+{
+	Tuple *tuple = pool_alloc(&tuple_pool);
+	tuple->length = length;
+	tuple->capacity = length;
+	tuple->kind = kind;
+	tuple->items = malloc(item_size(kind) * (length == 0 ? 1 : length));
+	tuple->base = NULL;
+	return heap_data(T_TUPLE, tuple);
+}
+
+/// The kind of tuple a value can be packed into, as one of its items.
+static inline TupleKind item_kind(const DataValue *value)
+{
+	if (value->type != T_NUMBER)
+		return TUPLE_ITEMS;
+	switch (value->number.type) {
+	case INT:   return TUPLE_INTS;
+	case FLOAT: return TUPLE_FLOATS;
+	default:    return TUPLE_ITEMS;
+	}
+}
+
+/// Store a value as item `i' of a tuple, which gains a reference to
+/// it, or only its number if packed.
+static inline void store_item(Tuple *tuple, usize i, DataValue *value)
+{
+	switch (tuple->kind) {
+	case TUPLE_INTS:   tuple->ints[i] = value->number.value.i; break;
+	case TUPLE_FLOATS: tuple->floats[i] = value->number.value.f; break;
+	default:           tuple->items[i] = link_datavalue(value); break;
+	}
+}
+
+/// Copy `count' items of one tuple from `offset' on into another from
+/// `at' on.  Packed tuples only take items of their own kind (or the
+/// integers of a range), tuples of values take any.
+static void copy_items(Tuple *into, usize at, const Tuple *from, usize offset, usize count)
+{
+	if (into->kind == TUPLE_ITEMS) {
+		for (usize i = 0; i < count; ++i)
+			into->items[at + i] = tuple_item(from, offset + i);
+	} else if (from->kind == TUPLE_RANGE) {
+		for (usize i = 0; i < count; ++i)
+			into->ints[at + i] = from->range.start
+				+ (ssize)(offset + i) * from->range.step;
+	} else {
+		usize size = item_size(into->kind);
+		memcpy((byte *)into->items + at * size,
+			(const byte *)from->items + offset * size, count * size);
+	}
+}
+
+/// A tuple of the given items, each gaining a reference.  Numbers all
+/// of one type are packed instead.
+DataValue *make_tuple(DataValue **items, usize length)
+{
+	TupleKind kind = length > 0 ? item_kind(items[0]) : TUPLE_ITEMS;
+	for (usize i = 1; i < length && kind != TUPLE_ITEMS; ++i)
+		if (item_kind(items[i]) != kind)
+			kind = TUPLE_ITEMS;
+	DataValue *data = alloc_tuple(kind, length);
+	Tuple *tuple = data->value;
+	for (usize i = 0; i < length; ++i)
+		store_item(tuple, i, items[i]);
+	return data;
+}
+
+/// Apply a builtin to each item of a tuple, giving a tuple of the
+/// results, or NULL (with an error) if it fails for any of them.
+DataValue *map_tuple(FUNC_PTR(fn), const Tuple *tuple)
+{
+	DataValue *result = NULL;
+	DataValue **items = malloc(sizeof(DataValue *) * (tuple->length + 1));
+	usize done = 0;
+	for (; done < tuple->length; ++done) {
+		DataValue *item = tuple_item(tuple, done);
+		items[done] = fn(*item);
+		unlink_datavalue(item);
+		if (items[done] == NULL)
+			break;
+	}
+	if (done == tuple->length)
+		result = make_tuple(items, done);
+	for (usize i = 0; i < done; ++i)
+		unlink_datavalue(items[i]);
+	free(items);
+	return result;
+}
+
+/// The range of `length' integers from `start' on, `step' apart.
+static DataValue *range_tuple(ssize start, ssize step, usize length)
+{
+	Tuple *range = pool_alloc(&tuple_pool);
+	range->length = length;
+	range->capacity = 0;
+	range->kind = TUPLE_RANGE;
+	range->items = NULL;
+	range->range.start = start;
+	range->range.step = step;
+	return heap_data(T_TUPLE, range);
+}
+
+/// Item `i' of a tuple, with a reference for the caller.  The items of
+/// packed tuples and ranges are made as they are asked for.
+DataValue *tuple_item(const Tuple *tuple, usize i)
+{
+	switch (tuple->kind) {
+	case TUPLE_INTS:
+		return number_data((NumberNode){ INT, { .i = tuple->ints[i] } });
+	case TUPLE_FLOATS:
+		return number_data((NumberNode){ FLOAT, { .f = tuple->floats[i] } });
+	case TUPLE_RANGE: {
+		ssize n = tuple->range.start + (ssize)i * tuple->range.step;
+		return number_data((NumberNode){ INT, { .i = n } });
+	}
+	default:
+		return link_datavalue(tuple->items[i]);
+	}
+}
+
+/// The `length' items of a tuple from `offset' on, as a slice sharing
+/// them, which costs the same however long it is.  The tuple owning
+/// the items is kept alive for as long as the slice.
+DataValue *slice_tuple(DataValue *data, usize offset, usize length)
+{
+	Tuple *whole = data->value;
+	if (offset == 0 && length == whole->length)
+		return link_datavalue(data);
+	if (whole->kind == TUPLE_RANGE)
+		return range_tuple(whole->range.start + (ssize)offset * whole->range.step,
+			whole->range.step, length);
+	Tuple *slice = pool_alloc(&tuple_pool);
+	slice->length = length;
+	slice->capacity = 0;
+	slice->kind = whole->kind;
+	slice->items = (void *)((byte *)whole->items + offset * item_size(whole->kind));
+	// Slices of slices refer to the owner, not to each other.
+	slice->base = link_datavalue(whole->base != NULL ? whole->base : data);
+	return heap_data(T_TUPLE, slice);
+}
+
+/// The range of the integers from `a' to `b' inclusive, (a:b), which is
+/// empty if `b' comes before `a'.  It takes the same space however long
+/// it is (see `tuple_item').  Neither side is unlinked.
+DataValue *make_range(DataValue *lhs, DataValue *rhs)
+{
+	NumberNode *from = type_check(":", LHS, T_NUMBER, lhs);
+	NumberNode *to = type_check(":", RHS, T_NUMBER, rhs);
+	if (from == NULL || to == NULL)
+		return NULL;
+	if (from->type != INT || to->type != INT) {
+		ERROR_TYPE = TYPE_ERROR;
+		strcpy(ERROR_MSG, "Range `:' must be between integers.");
+		return NULL;
+	}
+	ssize start = from->value.i, stop = to->value.i;
+	if (stop < start)
+		return range_tuple(start, 1, 0);
+	// Items are indexed by signed integers, so there may be no more.
+	usize span = (usize)stop - (usize)start;
+	if (span >= PTRDIFF_MAX) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Range `:' may have at most %td items.", PTRDIFF_MAX);
+		return NULL;
+	}
+	return range_tuple(start, 1, span + 1);
+}
+
+/// Elements of a chain of the tuple (,) operator.
+usize tuple_elements(const ParseNode *chain)
+{
+	usize count = 1;
+	for (; is_operation(chain, OPR_COMMA); chain = binary_right(chain))
+		++count;
+	return count;
+}
+
+// What an empty tuple adds, which fits in any kind of tuple.
+#define NO_ITEMS ((TupleKind)-1)
+
+/// The kind of tuple that can hold what a value adds to one, which is
+/// its items if spliced.
+static inline TupleKind spliced_kind(const DataValue *value, bool spliced)
+{
+	if (!spliced)
+		return item_kind(value);
+	const Tuple *tuple = value->value;
+	if (tuple->length == 0)
+		return NO_ITEMS;
+	return tuple->kind == TUPLE_RANGE ? TUPLE_INTS : tuple->kind;
+}
+
+/// Put the items a value adds to a tuple from `at' on, giving how many.
+static inline usize splice_items(Tuple *tuple, usize at, DataValue *value, bool spliced)
+{
+	if (!spliced) {
+		store_item(tuple, at, value);
+		return 1;
+	}
+	const Tuple *items = value->value;
+	copy_items(tuple, at, items, 0, items->length);
+	return items->length;
+}
+
+/// Join the values of the elements of a (,) chain into one tuple, in
+/// order.  Splatted elements (where `splats' is true, or none if it is
+/// NULL), and a tuple as the last element, have their items spliced
+/// in, since (a, (b, c)) == (a, b, c).  The tuple is sized once, or
+/// built in the storage of the last element when that tuple is not
+/// shared.  Numbers all of one type are packed.
+/// None of the values are unlinked.
+DataValue *join_tuple(DataValue **values, usize count, const bool *splats)
+{
+	usize length = 0;
+	TupleKind kind = NO_ITEMS;
+	for (usize i = 0; i < count; ++i) {
+		bool splat = splats != NULL && splats[i];
+		if (splat && values[i]->type != T_TUPLE) {
+			ERROR_TYPE = EXECUTION_ERROR;
+			strcpy(ERROR_MSG, "Cannot splat non-tuple.");
+			return NULL;
+		}
+		bool spliced = splat || (i == count - 1 && values[i]->type == T_TUPLE);
+		length += spliced ? ((Tuple *)values[i]->value)->length : 1;
+		TupleKind adds = spliced_kind(values[i], spliced);
+		if (kind == NO_ITEMS)
+			kind = adds;
+		else if (adds != kind && adds != NO_ITEMS)
+			kind = TUPLE_ITEMS;
+	}
+	if (kind == NO_ITEMS)
+		kind = TUPLE_ITEMS;
+
+	DataValue *last = values[count - 1];
+	Tuple *tail = last->type == T_TUPLE ? last->value : NULL;
+	DataValue *result;
+	Tuple *tuple;
+	usize fill = count;
+	if (tail != NULL && tail->kind == kind && tail->base == NULL
+	&&  last->refcount == 1 && !last->onstack) {
+		// Nothing else sees the tail, so prepend to it in place.
+		result = link_datavalue(last);
+		tuple = tail;
+		usize size = item_size(kind);
+		if (tuple->capacity < length) {
+			tuple->capacity = length < 2 * tuple->capacity
+				? 2 * tuple->capacity : length;
+			tuple->items = realloc(tuple->items, size * tuple->capacity);
+		}
+		memmove((byte *)tuple->items + (length - tuple->length) * size,
+			tuple->items, size * tuple->length);
+		fill = count - 1;  // Its items are already in place.
+	} else {
+		result = alloc_tuple(kind, length);
+		tuple = result->value;
+	}
+	tuple->length = length;
+
+	usize filled = 0;
+	for (usize i = 0; i < fill; ++i) {
+		bool splat = splats != NULL && splats[i];
+		bool spliced = splat || (i == count - 1 && values[i]->type == T_TUPLE);
+		filled += splice_items(tuple, filled, values[i], spliced);
+	}
+	return result;
+}
+
+/// Adding, subtracting or multiplying a range by an integer gives
+/// another range, the items still computed when asked for.  NULL if
+/// the operands are anything else.
+static DataValue *range_operation(OperatorKind op, DataValue *lhs, DataValue *rhs)
+{
+	bool left = lhs->type == T_TUPLE;
+	const Tuple *range = (left ? lhs : rhs)->value;
+	const DataValue *other = left ? rhs : lhs;
+	if (range->kind != TUPLE_RANGE
+	||  other->type != T_NUMBER || other->number.type != INT)
+		return NULL;
+	ssize n = other->number.value.i;
+	ssize start = range->range.start, step = range->range.step;
+	switch (op) {
+	case OPR_ADD:
+		return range_tuple(start + n, step, range->length);
+	case OPR_SUB:
+		return left
+			? range_tuple(start - n, step, range->length)
+			: range_tuple(n - start, -step, range->length);
+	case OPR_MUL:
+		return range_tuple(start * n, step * n, range->length);
+	default:
+		return NULL;
+	}
+}
+
+/// View a number, or a tuple, as packed numbers.  Items not already
+/// packed are copied out, into a `buffer' to be freed.  False if the
+/// value is not all numbers of one type.
+bool number_array(const DataValue *value, NumberArray *array, void **buffer)
+{
+	if (value->type == T_NUMBER) {
+		array->type = value->number.type;
+		array->scalar = true;
+		array->numbers = &value->number.value;
+		return item_kind(value) != TUPLE_ITEMS;
+	}
+	if (value->type != T_TUPLE)
+		return false;
+	const Tuple *tuple = value->value;
+	array->scalar = false;
+	array->numbers = tuple->items;
+	switch (tuple->kind) {
+	case TUPLE_INTS:   array->type = INT;   return true;
+	case TUPLE_FLOATS: array->type = FLOAT; return true;
+	default: break;
+	}
+	// Ranges, and tuples of numbers which were not packed when made.
+	Tuple numbers = { .length = tuple->length, .kind = TUPLE_INTS };
+	if (tuple->kind == TUPLE_ITEMS && tuple->length > 0)
+		numbers.kind = item_kind(tuple->items[0]);
+	for (usize i = 0; tuple->kind == TUPLE_ITEMS && i < tuple->length; ++i)
+		if (item_kind(tuple->items[i]) != numbers.kind)
+			return false;
+	if (numbers.kind == TUPLE_ITEMS)
+		return false;
+	numbers.items = *buffer = malloc(item_size(numbers.kind) * (tuple->length + 1));
+	copy_items(&numbers, 0, tuple, 0, tuple->length);
+	array->type = numbers.kind == TUPLE_INTS ? INT : FLOAT;
+	array->numbers = *buffer;
+	return true;
+}
+
+/// Whether a tuple packed as numbers of a kind is only referred to by
+/// the caller, who is about to discard it, and owns its numbers.
+static inline bool reusable(const DataValue *value, TupleKind kind)
+{
+	if (value->type != T_TUPLE || value->refcount != 1 || value->onstack)
+		return false;
+	const Tuple *tuple = value->value;
+	return tuple->kind == kind && tuple->base == NULL;
+}
+
+/// Arithmetic with a tuple applies to each of its items in turn, paired
+/// with the items of another tuple of the same length, or with the same
+/// number each time.  Numbers all of one type are computed all at once
+/// (see `array_operation'), anything else item by item.
+static DataValue *tuple_operation(OperatorKind op, DataValue *lhs, DataValue *rhs)
+{
+	const Tuple *l = lhs->type == T_TUPLE ? lhs->value : NULL;
+	const Tuple *r = rhs->type == T_TUPLE ? rhs->value : NULL;
+	usize length = l != NULL ? l->length : r->length;
+	if (l != NULL && r != NULL && l->length != r->length) {
+		ERROR_TYPE = EXECUTION_ERROR;
+		sprintf(ERROR_MSG, "Cannot use `%s' on tuples of"
+			" different lengths, %lu and %lu.",
+			operator_name(op), l->length, r->length);
+		return NULL;
+	}
+	DataValue *result = range_operation(op, lhs, rhs);
+	if (result != NULL)
+		return result;
+
+	NumberArray left, right;
+	void *lbuf = NULL, *rbuf = NULL;
+	if (number_array(lhs, &left, &lbuf) && number_array(rhs, &right, &rbuf)) {
+		TupleKind kind = array_result(op, left.type, right.type) == INT
+			? TUPLE_INTS : TUPLE_FLOATS;
+		// As with `number_result', an operand no one else refers to
+		// holds the result, which saves allocating it.
+		if (reusable(lhs, kind))
+			result = link_datavalue(lhs);
+		else if (reusable(rhs, kind))
+			result = link_datavalue(rhs);
+		else
+			result = alloc_tuple(kind, length);
+		if (!array_operation(op, &left, &right, length, ((Tuple *)result->value)->items)) {
+			unlink_datavalue(result);
+			result = NULL;
+		}
+		free(lbuf);
+		free(rbuf);
+		return result;
+	}
+	free(lbuf);
+	free(rbuf);
+
+	// Tuples of tuples, or of numbers of mixed types.
+	DataValue **items = malloc(sizeof(DataValue *) * (length + 1));
+	usize done = 0;
+	for (; done < length; ++done) {
+		DataValue *a = l != NULL ? tuple_item(l, done) : link_datavalue(lhs);
+		DataValue *b = r != NULL ? tuple_item(r, done) : link_datavalue(rhs);
+		items[done] = binary_operation(op, a, b);
+		unlink_datavalue(a);
+		unlink_datavalue(b);
+		if (items[done] == NULL)
+			break;
+	}
+	if (done == length)
+		result = make_tuple(items, length);
+	for (usize i = 0; i < done; ++i)
+		unlink_datavalue(items[i]);
+	free(items);
+	return result;
+}
+
+static void reindex_locals(Context *, usize);
+
+/// Unbind every local past the first `count'.
+void truncate_locals(Context *ctx, usize count)
+{
+	if (ctx->locals_count <= count)
+		return;
+	if (ctx->superior == NULL)
+		++binding_epoch;
+	while (ctx->locals_count > count)
+		unlink_datavalue(ctx->locals[--ctx->locals_count].value);
+	if (ctx->index != NULL)
+		reindex_locals(ctx, ctx->index_capacity);
+}
+
+/// Bind every local of `from' in `to' as well.
+void export_locals(Context *from, Context *to)
+{
+	for (usize i = 0; i < from->locals_count; ++i) {
+		Local local = from->locals[i];
+		bind_local(to, local.name, local.value);
+	}
+}
+
 void *type_check(const char *function_name, ParamPos pos,
 	DataType type, const DataValue *value)
 {
-	if (value != NULL
-	&& value->value != NULL
-	&& (value->type & type) != 0)
-		return (void *)value->value;
+	if (value != NULL && (value->type & type) != 0) {
+		if (value->type == T_NUMBER)
+			return (void *)&value->number;
+		if (value->value != NULL)
+			return (void *)value->value;
+	}
 
 	ERROR_TYPE = TYPE_ERROR;
 	sprintf(ERROR_MSG, "Wrong type for %s of `%s' operation,\n"
@@ -576,20 +1168,19 @@ DataValue *copy_data(DataValue *data)
 	switch (data->type) {
 		case T_NIL: return (DataValue *)&nil;
 		case T_TUPLE: {
-			Tuple *tup = malloc(sizeof(Tuple));
-			*tup = *(Tuple *)data->value;
-			return heap_data(T_TUPLE, tup);
+			// Items are shared, each gaining a reference.
+			const Tuple *tup = data->value;
+			if (tup->kind == TUPLE_RANGE)
+				return range_tuple(tup->range.start, tup->range.step, tup->length);
+			DataValue *copy = alloc_tuple(tup->kind, tup->length);
+			copy_items(copy->value, 0, tup, 0, tup->length);
+			return copy;
 		}
 		case T_LAMBDA: {
-			Lambda *lam = malloc(sizeof(Lambda));
-			*lam = *(Lambda *)data->value;
-			return heap_data(T_LAMBDA, lam);
-		}
-		case T_NUMBER: {
-			NumberNode *num = malloc(sizeof(NumberNode));
-			*num = *(NumberNode *)data->value;
-			return heap_data(T_NUMBER, num);
+			const Lambda *lam = data->value;
+			return heap_data(T_LAMBDA, copy_lambda(lam, lam->scope));
 		}
+		case T_NUMBER: return number_data(data->number);
 		case T_STRING: {
 			char *str = strdup(data->value);
 			return heap_data(T_STRING, str);
@@ -603,30 +1194,103 @@ DataValue *copy_data(DataValue *data)
 	return NULL;
 }
 
-Local make_local(const char *name, DataValue *data)
+Local make_local(Symbol name, DataValue *data)
 {
 	return (Local){
-		.name = strdup(name),
+		.name = name,
 		.value = link_datavalue(data),
 	};
 }
 
 
-static char *find_op_name(const ParseNode *unary)
+static bool find_op_name(const ParseNode *unary, Symbol *name)
 {
-	while (unary->type == UNARY_NODE)
-		unary = unary->node.unary.callee;
+	while (is_application(unary))
+		unary = unary_callee(unary);
 
-	if (unary->type == IDENT_NODE)
-		return unary->node.ident.value;
+	if (unary->type != IDENT_NODE)
+		return false;
 
-	return NULL;
+	*name = unary->node.ident.symbol;
+	return true;
+}
+
+static PatternTable *alloc_patterns(void)
+{
+	PatternTable *table = malloc(sizeof(PatternTable));
+	table->refcount = 1;
+	init(table->patterns, 1);
+	table->index = (PatternIndex){ 0 };
+	return table;
+}
+
+/// A lambda of no patterns yet, and no scope.
+static Lambda *alloc_lambda(Symbol name)
+{
+	Lambda *lam = malloc(sizeof(Lambda));
+	lam->name = name;
+	lam->table = alloc_patterns();
+	lam->scope = NULL;
+	lam->memo = NULL;
+	lam->native = NULL;
+	return lam;
+}
+
+/// Copy of a lambda in the given scope (if any), sharing its patterns.
+/// Remembered results and machine code belong to the original.
+Lambda *copy_lambda(const Lambda *lambda, Context *scope)
+{
+	Lambda *lam = malloc(sizeof(Lambda));
+	lam->name = lambda->name;
+	lam->table = link_patterns(lambda->table);
+	lam->scope = scope == NULL ? NULL : link_context(scope);
+	lam->memo = NULL;
+	lam->native = NULL;
+	return lam;
+}
+
+void free_lambda(Lambda *lambda)
+{
+	if (lambda->memo != NULL)
+		free_memo(lambda->memo);
+	if (lambda->native != NULL)
+		release_native(lambda->native);
+	unlink_patterns(lambda->table);
+	free(lambda);
+}
+
+inline
+PatternTable *link_patterns(PatternTable *table)
+{
+	++table->refcount;
+	return table;
+}
+
+/// Patterns go with the last lambda sharing them.
+void unlink_patterns(PatternTable *table)
+{
+	if (--table->refcount > 0)
+		return;
+	for (usize i = 0; i < table->patterns.len; ++i) {
+		LambdaPattern *lampat = &table->patterns.buf[i];
+		free_parsenode((ParseNode *)lampat->pattern);
+		if (lampat->body_type == LambdaBody) {
+			free_lambda((Lambda *)lampat->lambda);
+		} else {
+			free_parsenode((ParseNode *)lampat->body);
+			free_chunk((Chunk *)lampat->chunk);
+		}
+	}
+	free(table->patterns.buf);
+	free(table->index.general.buf);
+	free(table->index.literals);
+	free(table);
 }
 
 Lambda *register_lambda_pattern(Context *ctx, const ParseNode *lhs, const ParseNode *rhs)
 {
-	char *func_name = find_op_name(lhs);
-	if (func_name == NULL) {
+	Symbol func_name;
+	if (!find_op_name(lhs, &func_name)) {
 		ERROR_TYPE = PARSE_ERROR;
 		strcpy(ERROR_MSG, "Function assignment must have"
 			" identifier as function name.");
@@ -637,32 +1301,208 @@ Lambda *register_lambda_pattern(Context *ctx, const ParseNode *lhs, const ParseN
 		// Function exists, so register this as another pattern.
 		DataValue *val = defined_func->value;
 		if (val->type != T_LAMBDA) {
-			// Error.
+			ERROR_TYPE = EXECUTION_ERROR;
+			sprintf(ERROR_MSG, "Cannot define a pattern for `%s',"
+				" which is not a function.", symbol_name(func_name));
+			return NULL;
 		}
 		Lambda *lam = (Lambda *)val->value;
+		// The code shares the patterns, let go of it first, so they
+		// are not copied for its sake.
+		if (lam->native != NULL)
+			release_native(lam->native);
+		lam->native = NULL;  // Compiled again, with the new pattern.
 		append_pattern(lam, lhs, rhs);
+		if (lam->memo != NULL)
+			clear_memo(lam->memo);  // Results may no longer hold.
 		return lam;
 	}
 
 	// Otherwise, we define a new lambda under this name.
-	Lambda *lam = malloc(sizeof(Lambda));
-	lam->name = strdup(func_name);
-	init(lam->patterns, 1);
+	Lambda *lam = alloc_lambda(func_name);
 	append_pattern(lam, lhs, rhs);
-	lam->scope = ctx;
+	lam->scope = link_context(ctx);
 	return lam;
 }
 
-Lambda *make_lambda(Context *ctx, const char *name, const ParseNode *operand, const ParseNode *body)
+/// Upper bound on the names a pattern binds: its identifiers.
+static usize count_bindings(const ParseNode *pattern)
 {
-	Lambda *lam = malloc(sizeof(Lambda));
-	lam->name = strdup(name);
-	init(lam->patterns, 1);
-	append_pattern(lam, operand, body);
-	lam->scope = ctx;
+	// The subtree is the `size' nodes ending at its root.
+	usize count = 0;
+	for (usize i = 0; i < pattern->size; ++i)
+		count += (pattern - i)->type == IDENT_NODE;
+	return count;
+}
+
+/// Locals a call of the lambda needs room for, to start with.
+usize frame_size(const Lambda *lambda)
+{
+	usize size = 0;
+	const PatternTable *table = lambda->table;
+	for (usize i = 0; i < table->patterns.len; ++i)
+		if (table->patterns.buf[i].bindings > size)
+			size = table->patterns.buf[i].bindings;
+	return size;
+}
+
+static inline usize hash_pointer(const void *ptr, usize capacity)
+{
+	u64 hash = (uintptr_t)ptr * 11400714819323198485llu;  // Fibonacci hashing.
+	return (hash >> 32) & (capacity - 1);
+}
+
+static void insert_literal(PatternIndex *index, const DataValue *key, u32 pattern)
+{
+	usize i = hash_pointer(key, index->capacity);
+	while (index->literals[i].key != NULL) {
+		if (index->literals[i].key == key)
+			return;  // An earlier pattern already matches it.
+		i = (i + 1) & (index->capacity - 1);
+	}
+	index->literals[i].key = key;
+	index->literals[i].pattern = pattern;
+	++index->count;
+}
+
+/// Describe the newly added pattern `i' of a lambda, and index it.
+static void index_pattern(PatternTable *table, u32 i)
+{
+	LambdaPattern *lampat = &table->patterns.buf[i];
+	const ParseNode *pattern = lampat->pattern;
+	PatternIndex *index = &table->index;
+
+	lampat->bindings = count_bindings(pattern);
+	lampat->arity = -1;
+	lampat->splat = false;
+	if (is_operation(pattern, OPR_COMMA)) {
+		lampat->arity = 1;
+		for (; is_operation(pattern, OPR_COMMA); pattern = binary_right(pattern))
+			++lampat->arity;
+		lampat->splat = is_operation(pattern, OPR_SPLAT);
+	}
+
+	if (lampat->pattern->type != NUMBER_NODE) {
+		push(u32, &index->general, i);
+		return;
+	}
+	// Keep the table at most half full.
+	if (2 * (index->count + 1) > index->capacity) {
+		struct _literal_pattern *old = index->literals;
+		usize old_capacity = index->capacity;
+		index->capacity = old_capacity == 0 ? 16 : 2 * old_capacity;
+		index->literals = calloc(index->capacity, sizeof(*index->literals));
+		index->count = 0;
+		for (usize j = 0; j < old_capacity; ++j)
+			if (old[j].key != NULL)
+				insert_literal(index, old[j].key, old[j].pattern);
+		free(old);
+	}
+	insert_literal(index, constant_number(lampat->pattern->node.number), i);
+}
+
+/// Pattern matching the number literal the operand is equal to, if any.
+static u32 find_literal(const PatternIndex *index, const DataValue *operand)
+{
+	if (index->count == 0 || operand->type != T_NUMBER)
+		return UINT32_MAX;
+	const DataValue *key = find_constant_number(&operand->number);
+	if (key == NULL)
+		return UINT32_MAX;
+	usize i = hash_pointer(key, index->capacity);
+	for (; index->literals[i].key != NULL; i = (i + 1) & (index->capacity - 1))
+		if (index->literals[i].key == key)
+			return index->literals[i].pattern;
+	return UINT32_MAX;
+}
+
+/// Whether a pattern could match the operand at all, going by its shape.
+static inline bool may_match(const LambdaPattern *lampat, const DataValue *operand)
+{
+	if (lampat->arity < 0)
+		return true;
+	if (operand->type != T_TUPLE)
+		return false;
+	usize length = ((Tuple *)operand->value)->length;
+	return lampat->splat
+		? length >= (usize)lampat->arity
+		: length == (usize)lampat->arity;
+}
+
+/// Match an operand against the patterns of a lambda, binding into
+/// the (empty) call context.  The first pattern in order to match is
+/// returned, NULL if none do, with nothing bound.
+const LambdaPattern *match_lambda(Context *ctx, const Lambda *lambda, DataValue *operand)
+{
+	const PatternTable *table = lambda->table;
+	const PatternIndex *index = &table->index;
+	// Only one of the literal patterns can match, and it binds nothing,
+	// so only the other patterns before it need to be tried.
+	u32 literal = find_literal(index, operand);
+	for (usize i = 0; i < index->general.len; ++i) {
+		u32 j = index->general.buf[i];
+		if (j > literal)
+			break;
+		const LambdaPattern *lampat = &table->patterns.buf[j];
+		if (!may_match(lampat, operand))
+			continue;
+		if (match_local(ctx, lampat->pattern, operand))
+			return lampat;
+		// Forget anything a partial match bound.
+		truncate_locals(ctx, 0);
+	}
+	if (literal != UINT32_MAX)
+		return &table->patterns.buf[literal];
+	return NULL;
+}
+
+Lambda *make_lambda(Context *ctx, Symbol name, const ParseNode *operand, const ParseNode *body)
+{
+	Lambda *lam = alloc_lambda(name);
+	// The operand is the pattern itself, not a call pattern.
+	const ParseNode *owned_pattern = clone_node(operand);
+	const ParseNode *owned_body = clone_node(body);
+	push(LambdaPattern, &lam->table->patterns, ((LambdaPattern){
+		.pattern = owned_pattern,
+		.body_type = ParseNodeBody,
+		.body = owned_body,
+		.chunk = compile(owned_body, owned_pattern),
+	}));
+	index_pattern(lam->table, 0);
+	// Templates (no scope yet) get their scope when evaluated.
+	lam->scope = ctx == NULL ? NULL : link_context(ctx);
 	return lam;
 }
 
+/// Copy of a pattern, owning a copy of everything it owns.
+static LambdaPattern copy_pattern(const LambdaPattern *lampat)
+{
+	LambdaPattern copy = *lampat;
+	copy.pattern = clone_node(lampat->pattern);
+	if (lampat->body_type == LambdaBody) {
+		copy.lambda = copy_lambda(lampat->lambda, NULL);
+	} else {
+		copy.body = clone_node(lampat->body);
+		copy.chunk = compile(copy.body, copy.pattern);
+	}
+	return copy;
+}
+
+/// Patterns of a lambda, about to be added to, so first
+/// copied if other lambdas share them.
+static PatternTable *own_patterns(Lambda *lambda)
+{
+	PatternTable *shared = lambda->table;
+	if (shared->refcount == 1)
+		return shared;
+	PatternTable *table = alloc_patterns();
+	for (usize i = 0; i < shared->patterns.len; ++i) {
+		push(LambdaPattern, &table->patterns, copy_pattern(&shared->patterns.buf[i]));
+		index_pattern(table, i);
+	}
+	unlink_patterns(shared);
+	return lambda->table = table;
+}
 
 // Append a pattern+body to a lambda, given a call pattern.
 // e.g. a curried function
@@ -671,78 +1511,112 @@ Lambda *make_lambda(Context *ctx, const char *name, const ParseNode *operand, co
 // 	  lam { pat = a; body = lam { pat = b; body = lam { pat = c; body = defn } } }
 void append_pattern(Lambda *lambda, const ParseNode *call, const ParseNode *body)
 {
+	PatternTable *table = own_patterns(lambda);
 	// Basic case: Not curried.
-	if (call->node.unary.callee->type != UNARY_NODE) {
-		usize last = lambda->patterns.len++;
-		grow(Pattern, &lambda->patterns);
-		lambda->patterns.buf[last] = (LambdaPattern){
-			.pattern = clone_node(call->node.unary.operand),
+	if (!is_application(unary_callee(call))) {
+		const ParseNode *owned_pattern = clone_node(unary_operand(call));
+		const ParseNode *owned_body = clone_node(body);
+		push(LambdaPattern, &table->patterns, ((LambdaPattern){
+			.pattern = owned_pattern,
 			.body_type = ParseNodeBody,
-			.body = clone_node(body),
-		};
+			.body = owned_body,
+			.chunk = compile(owned_body, owned_pattern),
+		}));
+		index_pattern(table, table->patterns.len - 1);
 		return;
 	}
 
 	// Create the innermost lambda which will evaluate to the body.
-	Lambda *nested_lambda = malloc(sizeof(Lambda));
-	nested_lambda->scope = NULL; // This gets determined at the callsite.
-	nested_lambda->name = "<curried>";
-	init(nested_lambda->patterns, 1);
-	nested_lambda->patterns.len++;
-	grow(Pattern, &nested_lambda->patterns);
-	nested_lambda->patterns.buf[0] = (LambdaPattern){
-		.pattern = clone_node(call->node.unary.operand),
+	// Its scope gets determined at the callsite.
+	Lambda *nested_lambda = alloc_lambda(SYM_CURRIED);
+	const ParseNode *owned_pattern = clone_node(unary_operand(call));
+	const ParseNode *owned_body = clone_node(body);
+	push(LambdaPattern, &nested_lambda->table->patterns, ((LambdaPattern){
+		.pattern = owned_pattern,
 		.body_type = ParseNodeBody,
-		.body = clone_node(body),
-	};
+		.body = owned_body,
+		.chunk = compile(owned_body, owned_pattern),
+	}));
+	index_pattern(nested_lambda->table, 0);
 
 	// Examine rest of calls.
-	call = call->node.unary.callee;
+	call = unary_callee(call);
 	// Drill down the function calls to find each pattern in a curried defn.
-	while (call->type == UNARY_NODE) {
-		if (call->node.unary.callee->type != UNARY_NODE) {
+	while (is_application(call)) {
+		if (!is_application(unary_callee(call))) {
 			// Final lambda node wraps the nested lambda.
-			//   lam { pat = call->node.unary.operand, body = nested_lam }
-			usize last = lambda->patterns.len++;
-			grow(Pattern, &lambda->patterns);
-			LambdaPattern pat = {
-				.pattern = clone_node(call->node.unary.operand),
+			//   lam { pat = unary_operand(call), body = nested_lam }
+			push(LambdaPattern, &table->patterns, ((LambdaPattern){
+				.pattern = clone_node(unary_operand(call)),
 				.body_type = LambdaBody,
 				.lambda = nested_lambda,
-			};
-			lambda->patterns.buf[last] = pat;
+			}));
+			index_pattern(table, table->patterns.len - 1);
 			return;
 		} else {
 			// Wrap the previous lambda in another lambda, and set
 			// nested_lambda to that wrapping lambda.
 			//   nested_lambda -> lam { body = nested_lambda }
-			Lambda *outer_lambda = malloc(sizeof(Lambda));
-			outer_lambda->name = "<curried>";
-			outer_lambda->scope = NULL;
-			init(outer_lambda->patterns, 1);
-			outer_lambda->patterns.len++;
-			grow(Pattern, &outer_lambda->patterns);
-			outer_lambda->patterns.buf[0] = (LambdaPattern){
-				.pattern = clone_node(call->node.unary.operand),
+			Lambda *outer_lambda = alloc_lambda(SYM_CURRIED);
+			push(LambdaPattern, &outer_lambda->table->patterns, ((LambdaPattern){
+				.pattern = clone_node(unary_operand(call)),
 				.body_type = LambdaBody,
 				.lambda = nested_lambda,
-			};
+			}));
+			index_pattern(outer_lambda->table, 0);
 			nested_lambda = outer_lambda;
 		}
-		call = call->node.unary.callee;
+		call = unary_callee(call);
+	}
+}
+
+static inline usize hash_symbol(Symbol name, usize capacity)
+{
+	u32 hash = name * 2654435769u;  // Fibonacci hashing.
+	return (hash ^ (hash >> 16)) & (capacity - 1);
+}
+
+/// (Re)build the hash index of a context's locals.
+/// The locals array itself stays in order of definition.
+static void reindex_locals(Context *ctx, usize capacity)
+{
+	free(ctx->index);
+	ctx->index = calloc(capacity, sizeof(u32));
+	ctx->index_capacity = capacity;
+	for (usize slot = 0; slot < ctx->locals_count; ++slot) {
+		usize i = hash_symbol(ctx->locals[slot].name, capacity);
+		while (ctx->index[i] != 0)
+			i = (i + 1) & (capacity - 1);
+		ctx->index[i] = slot + 1;
 	}
 }
 
-Local *search_locals(const Context *ctx, const char *ident_name)
+/// Find a local in this context only.
+Local *find_local(const Context *ctx, Symbol name)
+{
+	if (ctx->index == NULL) {
+		for (usize i = 0; i < ctx->locals_count; ++i)
+			if (ctx->locals[i].name == name)
+				return &ctx->locals[i];
+		return NULL;
+	}
+	usize mask = ctx->index_capacity - 1;
+	for (usize i = hash_symbol(name, ctx->index_capacity);
+	     ctx->index[i] != 0; i = (i + 1) & mask) {
+		Local *local = &ctx->locals[ctx->index[i] - 1];
+		if (local->name == name)
+			return local;
+	}
+	return NULL;
+}
+
+Local *search_locals(const Context *ctx, Symbol name)
 {
 	const Context *current_ctx = ctx;
 	while (current_ctx != NULL) {
-		for (usize i = 0; i < current_ctx->locals_count; ++i) {
-			Local *local = &current_ctx->locals[i];
-			if (strcmp(local->name, ident_name) == 0) {
-				return local;
-			}
-		}
+		Local *local = find_local(current_ctx, name);
+		if (local != NULL)
+			return local;
 		current_ctx = current_ctx->superior;
 	}
 	return NULL;
@@ -758,14 +1632,14 @@ bool match_local(Context *ctx, const ParseNode *pat, DataValue *val)
 
     // If pattern is an identifier, bind it to the value
     if (pat->type == IDENT_NODE) {
-        bind_local(ctx, pat->node.ident.value, val);  // Cast away const as bind_local will handle linking
+        bind_local(ctx, pat->node.ident.symbol, val);  // Cast away const as bind_local will handle linking
         return true;
     }
 
     // Match number literals
     if (pat->type == NUMBER_NODE && val->type == T_NUMBER) {
         NumberNode *pattern_num = (NumberNode*)&pat->node.number;
-        NumberNode *value_num = (NumberNode*)val->value;
+        NumberNode *value_num = &val->number;
 
         if (pattern_num->type != value_num->type) return false;
 
@@ -790,58 +1664,54 @@ bool match_local(Context *ctx, const ParseNode *pat, DataValue *val)
     if (val->type == T_TUPLE) {
         Tuple *tuple = (Tuple*)val->value;
 
+        // Check the length first, so nothing is bound if it is wrong.
+        usize count = tuple_elements(pat);
+        const ParseNode *last = pat;
+        while (is_operation(last, OPR_COMMA))
+            last = binary_right(last);
+        if (tuple->length < count
+        || (tuple->length != count && !is_operation(last, OPR_SPLAT)))
+            return false;
+
         // Match each element
-        ssize tuple_idx = tuple->length - 1;
+        usize index = 0;
         const ParseNode *curr = pat;
-        while (
-        	curr->type == BINARY_NODE
-	     && curr->node.binary.callee->type == IDENT_NODE
-	     && strcmp(curr->node.binary.callee->node.ident.value, ",") == 0
-        ) {
-            if (tuple_idx < 0) return false;
-            if (!match_local(ctx, curr->node.binary.left, tuple->items[tuple_idx--]))
-                return false;
-            curr = curr->node.binary.right;
+        while (is_operation(curr, OPR_COMMA)) {
+            if (index >= tuple->length) return false;
+            DataValue *item = tuple_item(tuple, index++);
+            bool matched = match_local(ctx, binary_left(curr), item);
+            unlink_datavalue(item);
+            if (!matched) return false;
+            curr = binary_right(curr);
         }
 
         // Match the final element
-        if (curr->type == UNARY_NODE) {
-        	// Check for `...` splat pattern.
-        	const ParseNode *op = curr->node.unary.callee;
-         	const ParseNode *pat = curr->node.unary.operand;
-         	if (op->type == IDENT_NODE && strcmp(op->node.ident.value, "...") == 0) {
-          		if (tuple_idx == 0)
-            		return match_local(ctx, pat, tuple->items[0]);
-          		// Create tuple linking trailing elements.
-            	Tuple *tail_tuple = malloc(sizeof(Tuple));
-             	tail_tuple->length = tuple_idx + 1;
-              	tail_tuple->capacity = tail_tuple->length;
-               	tail_tuple->items = calloc(tail_tuple->capacity, sizeof(DataValue *));
-          		for (usize i = 0; i < tail_tuple->length; ++i) {
-	            	tail_tuple->items[i] = link_datavalue(tuple->items[i]);
-	            }
-            	DataValue *tail = heap_data(T_TUPLE, tail_tuple);
-            	return match_local(ctx, pat, tail);
-          	}
+        if (index >= tuple->length) return false;
+        usize remaining = tuple->length - index;
+        if (is_operation(curr, OPR_SPLAT)) {
+            // Check for `...` splat pattern.
+            curr = unary_operand(curr);
+        } else if (remaining != 1) {
+            // Exactly one element must remain for the final pattern.
+            return false;
         }
-        return match_local(ctx, curr, tuple->items[tuple_idx]);
+        // The trailing elements, sharing the items of the tuple.
+        DataValue *tail = remaining == 1
+            ? tuple_item(tuple, index)
+            : slice_tuple(val, index, remaining);
+        bool matched = match_local(ctx, curr, tail);
+        unlink_datavalue(tail);
+        return matched;
     }
 
     return false;
 }
 
 // Locals is a dynamically growable array.
-void bind_local(Context *ctx, const char *name, DataValue *data)
+void bind_local(Context *ctx, Symbol name, DataValue *data)
 {
 	// Check if it already exists.
-	Local *local_ptr = NULL;
-	for (usize i = 0; i < ctx->locals_count; ++i) {
-		Local *l = ctx->locals + i;
-		if (strcmp(l->name, name) == 0) {
-			local_ptr = l;
-			break;
-		}
-	}
+	Local *local_ptr = find_local(ctx, name);
 	// Reassignment: slot already exists.
 	if (local_ptr != NULL) {
 		unlink_datavalue(local_ptr->value);  // one fewer things pointing to old allocated data.
@@ -849,16 +1719,34 @@ void bind_local(Context *ctx, const char *name, DataValue *data)
 		return;
 	}
 
+	// New globals may shadow, and growing may move, cached locals.
+	if (ctx->superior == NULL)
+		++binding_epoch;
 	// Check capacity.
-	if (ctx->locals_count >= ctx->locals_capacity) {
-		// Grow array.
-		ctx->locals_capacity *= LOCALS_REALLOC_GROWTH_FACTOR + 1;
-		ctx->locals = realloc(ctx->locals,
-			sizeof(Local) * ctx->locals_capacity);
-	}
+	if (ctx->locals_count >= ctx->locals_capacity)
+		grow_locals(ctx);
 
 	Local local = make_local(name, data);
 	ctx->locals[ctx->locals_count++] = local;
+
+	// Keep the index at most half full.
+	if (ctx->index != NULL && 2 * ctx->locals_count <= ctx->index_capacity) {
+		usize mask = ctx->index_capacity - 1;
+		usize i = hash_symbol(name, ctx->index_capacity);
+		while (ctx->index[i] != 0)
+			i = (i + 1) & mask;
+		ctx->index[i] = ctx->locals_count;
+	} else if (ctx->locals_count > LOCALS_INDEX_THRESHOLD) {
+		usize capacity = ctx->index_capacity == 0 ? 64 : 2 * ctx->index_capacity;
+		reindex_locals(ctx, capacity);
+	}
+}
+
+/// Bind a new value, which the scope then holds the only reference to.
+static void bind_new(Context *ctx, const char *name, DataValue *data)
+{
+	bind_local(ctx, symbol(name), data);
+	unlink_datavalue(data);
 }
 
 void bind_builtin_functions(Context *ctx)
@@ -866,54 +1754,125 @@ void bind_builtin_functions(Context *ctx)
 	for (usize i = 0; i < len(builtin_fns); ++i) {
 		struct _func_name_pair *pair =
 			(struct _func_name_pair *)(builtin_fns + i);
-		bind_local(ctx, pair->name, stack_data(T_FUNCTION_PTR, &pair->function));
+		bind_new(ctx, pair->name, stack_data(T_FUNCTION_PTR, &pair->function));
+		if (!pair->impure)
+			mark_constant(ctx, symbol(pair->name));
 	}
 }
 
 void bind_default_globals(Context *ctx)
 {
-	fsize pi = M_PI;
-	fsize e = M_E;
-	fsize inf = HUGE_VAL;
-	fsize nan = NAN;
-
-	bind_local(ctx, "nil", stack_data(T_NIL, NULL));
-	bind_local(ctx, "pi",  heap_data(T_NUMBER, make_number(FLOAT, &pi)));
-	bind_local(ctx, "e",   heap_data(T_NUMBER, make_number(FLOAT, &e)));
-	bind_local(ctx, "inf", heap_data(T_NUMBER, make_number(FLOAT, &inf)));
-	bind_local(ctx, "nan", heap_data(T_NUMBER, make_number(FLOAT, &nan)));
+	bind_new(ctx, "nil", stack_data(T_NIL, NULL));
+	bind_new(ctx, "pi",  number_data((NumberNode){ FLOAT, { .f = M_PI } }));
+	bind_new(ctx, "e",   number_data((NumberNode){ FLOAT, { .f = M_E } }));
+	bind_new(ctx, "inf", number_data((NumberNode){ FLOAT, { .f = HUGE_VAL } }));
+	bind_new(ctx, "nan", number_data((NumberNode){ FLOAT, { .f = NAN } }));
+	mark_constant(ctx, symbol("pi"));
+	mark_constant(ctx, symbol("e"));
+	mark_constant(ctx, symbol("inf"));
+	mark_constant(ctx, symbol("nan"));
 }
 
-Context *make_context(const char *scope_name, Context *super_scope)
+Context *make_context(Symbol scope_name, Context *super_scope)
 {
-	Context *ctx = malloc(sizeof(Context));
+	Context *ctx = pool_alloc(&context_pool);
 	ctx->refcount = 1;
 	ctx->function = scope_name;
 	ctx->superior = super_scope;
 	if (ctx->superior != NULL)  // Increment reference count to superior scope.
 		++ctx->superior->refcount;
+	else  // May take the place of a freed global scope.
+		++binding_epoch;
 
 	// Initialise with 6 free spaces for local variables.
 	// This may have to be reallocated if more than 6
 	// variables need to exist :^).
-	ctx->locals_count = 1;
+	ctx->locals_count = 0;
 	ctx->locals_capacity = 6;
 	ctx->locals = malloc(sizeof(Local) * ctx->locals_capacity);
+	ctx->locals_on_stack = false;
+	ctx->stack_mark = 0;
+	ctx->index_capacity = 0;
+	ctx->index = NULL;
+
+	return ctx;
+}
 
-	// Create an initial local variable with the value of the
-	// name of the function/scope.
-	Local this_scope = make_local("__this_scope",
-		stack_data(T_STRING, (void *)ctx->function));
-	Local ans = make_local("Ans",
-		heap_data(T_NUMBER, make_number(FLOAT, (fsize *)&ZERO)));
-	ctx->locals[0] = this_scope;
-	ctx->locals[1] = ans;
-	// ^ Sets the first variable, default in every scope
-	// (good for debugging purposes).
+/// Make a context for a call, or a `let'/`where' scope, which is
+/// left (with `pop_context') before any context made after it.
+/// Its locals are taken from the frame stack, room for `size' of
+/// them to start with.
+Context *push_context(Symbol scope_name, Context *super_scope, usize size)
+{
+	Context *ctx = pool_alloc(&context_pool);
+	ctx->refcount = 1;
+	ctx->function = scope_name;
+	ctx->superior = super_scope;
+	if (ctx->superior != NULL)
+		++ctx->superior->refcount;
+
+	if (frame_locals.buf == NULL)
+		frame_locals.buf = malloc(sizeof(Local) * FRAME_LOCALS_CAPACITY);
+	size += FRAME_LOCALS_SLACK;
+
+	ctx->locals_count = 0;
+	ctx->locals_capacity = size;
+	ctx->stack_mark = frame_locals.top;
+	ctx->locals_on_stack = frame_locals.top + size <= FRAME_LOCALS_CAPACITY;
+	if (ctx->locals_on_stack) {
+		ctx->locals = frame_locals.buf + frame_locals.top;
+		frame_locals.top += size;
+	} else {
+		ctx->locals = malloc(sizeof(Local) * size);
+	}
+	ctx->index_capacity = 0;
+	ctx->index = NULL;
 
 	return ctx;
 }
 
+/// Move the locals of a context off the frame stack, with room
+/// for `capacity' of them.
+static void promote_locals(Context *ctx, usize capacity)
+{
+	Local *locals = malloc(sizeof(Local) * capacity);
+	memcpy(locals, ctx->locals, sizeof(Local) * ctx->locals_count);
+	ctx->locals = locals;
+	ctx->locals_capacity = capacity;
+	ctx->locals_on_stack = false;
+}
+
+/// Leave a context made by `push_context'.  Anything that still
+/// refers to it (e.g. a closure) keeps it alive, so its locals are
+/// moved to the heap, and the frame stack is popped either way.
+void pop_context(Context *ctx)
+{
+	usize mark = ctx->stack_mark;
+	if (ctx->locals_on_stack && ctx->refcount > 1)
+		promote_locals(ctx, ctx->locals_count);
+	unlink_context(ctx);
+	frame_locals.top = mark;
+}
+
+static void grow_locals(Context *ctx)
+{
+	usize capacity = ctx->locals_capacity * (LOCALS_REALLOC_GROWTH_FACTOR + 1) + 1;
+	if (!ctx->locals_on_stack) {
+		ctx->locals = realloc(ctx->locals, sizeof(Local) * capacity);
+		ctx->locals_capacity = capacity;
+		return;
+	}
+	// The newest context on the frame stack may grow in place.
+	usize end = ctx->locals - frame_locals.buf + ctx->locals_capacity;
+	usize extra = capacity - ctx->locals_capacity;
+	if (end == frame_locals.top && end + extra <= FRAME_LOCALS_CAPACITY) {
+		frame_locals.top += extra;
+		ctx->locals_capacity = capacity;
+		return;
+	}
+	promote_locals(ctx, capacity);
+}
+
 Context *base_context(void)
 {
 	Context *ctx = init_context();
@@ -927,5 +1886,14 @@ Context *base_context(void)
 // Create main parent context.
 Context *init_context(void)
 {
-	return make_context("<main>", NULL);
+	init_constants();
+	return make_context(SYM_MAIN, NULL);
+}
+
+/// Report how well the object pools are doing.
+void display_pools(FILE *file)
+{
+	display_pool(file, &datavalue_pool);
+	display_pool(file, &context_pool);
+	display_pool(file, &tuple_pool);
 }
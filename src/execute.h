@@ -2,33 +2,66 @@
 
 #include "defaults.h"
 #include "parse.h"
+#include "compile.h"
+#include "pool.h"
 
 /// Execution context / scope.
 struct _context;
 
 typedef enum {
 	T_NIL     = 1 << 0,  // Empty type.
-	T_NUMBER  = 1 << 1,  // NumberNode (ParsNode).
+	T_NUMBER  = 1 << 1,  // NumberNode (ParsNode), held inline.
 	T_STRING  = 1 << 2,  // Native char pointer.
 	T_TUPLE   = 1 << 3,  // List of contigious data values.
 	T_LAMBDA  = 1 << 4,  // User defined function.
 	T_FUNCTION_PTR = 1 << 5,  // Wrapper of native function pointer.
 } DataType;
 
-typedef struct {
+typedef struct _datavalue {
 	usize refcount;
 	bool onstack;
 	DataType type;
-	void *value;
+	union {
+		void *value;
+		NumberNode number;  // T_NUMBER, no separate allocation.
+	};
 } DataValue;
 
 // (a , (b , c)) == (a, b, c), so (,) is a cons operator.
+// A slice of a tuple is a view of part of its items, which holds
+// a reference to the tuple that owns them (see `slice_tuple').
+// A tuple of numbers all of one type is packed as those numbers,
+// and a range (a:b) stores no items at all, item i being start + i*step.
+// Items of either are only made into values when asked for.
+typedef enum {
+	TUPLE_ITEMS,   // Values, at `items'.
+	TUPLE_INTS,    // Packed integers, at `ints'.
+	TUPLE_FLOATS,  // Packed floats, at `floats'.
+	TUPLE_RANGE,   // Integers, not stored (see `tuple_item').
+} TupleKind;
+
 typedef struct {
 	usize length;
-	usize capacity;
-	DataValue **items;
+	usize capacity;    // Zero for slices and ranges, which own no items.
+	TupleKind kind;
+	union {
+		DataValue **items;
+		ssize *ints;
+		fsize *floats;
+	};
+	union {
+		DataValue *base;  // Tuple owning the items of a slice, or NULL.
+		struct { ssize start, step; } range;
+	};
 } Tuple;
 
+/// Numbers of one type packed together (see `number_array').
+typedef struct {
+	NumberType type;       // INT or FLOAT.
+	bool scalar;           // One number, standing for every item.
+	const void *numbers;   // Of `ssize' or `fsize'.
+} NumberArray;
+
 typedef struct {
     const ParseNode *pattern;
     const ParseNode *body;
@@ -36,17 +69,46 @@ typedef struct {
 
 typedef struct _lambda_pattern {
     const ParseNode *pattern;
+    usize bindings;  // Identifiers in the pattern, sizes call frames.
+    ssize arity;     // Elements of a tuple pattern, otherwise -1.
+    bool splat;      // Tuple pattern ends in `...rest'.
     enum { ParseNodeBody, LambdaBody } body_type;
     union {
         const struct _lambda *lambda;
         const ParseNode *body;
     };
+    const Chunk *chunk;  // Compiled `body', for ParseNodeBody patterns.
 } LambdaPattern;
 
-typedef struct _lambda {
-	char *name;
+/// Which patterns of a lambda may match what.  Number literal
+/// patterns are found by the constant they match (see constant.h),
+/// only the others need to be tried in turn.
+typedef struct {
+	array(u32) general;  // Patterns other than number literals, in order.
+	usize capacity;      // Of `literals', a power of two, or zero.
+	usize count;
+	struct _literal_pattern {
+		const DataValue *key;
+		u32 pattern;
+	} *literals;
+} PatternIndex;
+
+/// Patterns of a lambda, and their index.  Copies of a lambda share
+/// them, and they own the trees, compiled bodies and nested lambdas
+/// of their patterns.  Shared patterns are copied before one is added
+/// (see `append_pattern').
+typedef struct _pattern_table {
+	usize refcount;
 	array(LambdaPattern) patterns;
+	PatternIndex index;
+} PatternTable;
+
+typedef struct _lambda {
+	Symbol name;
+	PatternTable *table;
 	struct _context *scope;  // Scope the function was defined in.
+	struct _memo *memo;      // Remembered results (see `builtin_memo').
+	struct _native *native;  // Machine code, once called (see jit.c).
 } Lambda;
 
 #define FUNC_PTR(FUNC_NAME) \
@@ -56,25 +118,33 @@ typedef struct {
 	FUNC_PTR(fn);
 } FnPtr;
 
-typedef struct {
-	const char *name;
+typedef struct _local {
+	Symbol name;
 	DataValue *value;
 } Local;
 
 typedef struct _context {
 	usize refcount;
 	struct _context *superior;
-	const char *function;
+	Symbol function;
 	// `locals` works as a dynamic array;
 	usize locals_count;
 	usize locals_capacity;
 	Local *locals;
+	bool locals_on_stack;  // See `push_context'.
+	usize stack_mark;      // Frame stack top before this context.
+	// Hash index of (slot + 1) by name, once there are many locals.
+	usize index_capacity;  // Zero when not indexed.
+	u32 *index;
 } Context;
 
 typedef enum {
 	ARG, LHS, RHS
 } ParamPos;
 
+/// Computes into the last argument, returns false on error.
+typedef bool (*NumericOperation)(const NumberNode *, const NumberNode *, NumberNode *);
+
 void free_datavalue(DataValue *);
 DataValue *copy_data(DataValue *);
 DataValue *link_datavalue(DataValue *);
@@ -83,18 +153,54 @@ void free_context(Context *);
 Context *link_context(Context *);
 void unlink_context(Context *);
 Lambda *register_lambda_pattern(Context *, const ParseNode *, const ParseNode *);
-Lambda *make_lambda(Context *, const char *, const ParseNode *, const ParseNode *);
+Lambda *make_lambda(Context *, Symbol, const ParseNode *, const ParseNode *);
 void append_pattern(Lambda *, const ParseNode *, const ParseNode *);
+Lambda *copy_lambda(const Lambda *, Context *);
+void free_lambda(Lambda *);
+PatternTable *link_patterns(PatternTable *);
+void unlink_patterns(PatternTable *);
 void *type_check(const char *, ParamPos, DataType, const DataValue *);
 DataValue *execute(Context *, const ParseNode *);
+DataValue *execute_tree(Context *, const ParseNode *);
+DataValue *numeric_operation(const char *, NumericOperation, DataValue *, DataValue *);
+DataValue *unchecked_operation(NumericOperation, DataValue *, DataValue *);
+DataValue *binary_operation(OperatorKind, DataValue *, DataValue *);
+DataValue *unary_operation(OperatorKind, DataValue *);
+DataValue *apply_primitive(DataValue *, DataValue *);
+DataValue *alloc_tuple(TupleKind, usize);
+DataValue *make_tuple(DataValue **, usize);
+DataValue *map_tuple(FUNC_PTR(), const Tuple *);
+bool number_array(const DataValue *, NumberArray *, void **);
+DataValue *tuple_item(const Tuple *, usize);
+DataValue *slice_tuple(DataValue *, usize, usize);
+DataValue *make_range(DataValue *, DataValue *);
+usize tuple_elements(const ParseNode *);
+DataValue *join_tuple(DataValue **, usize, const bool *);
+void truncate_locals(Context *, usize);
+void export_locals(Context *, Context *);
 DataValue *wrap_data(DataType, void *, bool);
 DataValue *stack_data(DataType, void *);
 DataValue *heap_data(DataType, void *);
-Local *search_locals(const Context *, const char *);
-Local make_local(const char *, DataValue *);
-void bind_local(Context *, const char *, DataValue *);
+DataValue *number_data(NumberNode);
+Local *find_local(const Context *, Symbol);
+Local *search_locals(const Context *, Symbol);
+Local make_local(Symbol, DataValue *);
+void bind_local(Context *, Symbol, DataValue *);
 bool match_local(Context *, const ParseNode *, DataValue *);
 void bind_builtin_functions(Context *);
 Context *init_context(void);
 Context *base_context(void);
-Context *make_context(const char *, Context *);
+Context *make_context(Symbol, Context *);
+Context *push_context(Symbol, Context *, usize);
+void pop_context(Context *);
+usize frame_size(const Lambda *);
+const LambdaPattern *match_lambda(Context *, const Lambda *, DataValue *);
+void display_pools(FILE *);
+
+/// Changes whenever a global scope gains a binding, which may shadow
+/// or move what a `LoadCache' found.
+extern u64 binding_epoch;
+
+extern Pool datavalue_pool;
+extern Pool context_pool;
+extern Pool tuple_pool;
@@ -0,0 +1,451 @@
+#include "fold.h"
+
+/* --- Constant folding of parse trees, ahead of execution --- */
+
+bool folding = true;
+
+/// A global which may be replaced by its value, as long as it is still
+/// bound to the very same value (it has not been rebound since).
+/// Kept until the global scope it is bound in is freed.
+typedef struct {
+	const Context *ctx;
+	Symbol name;
+	DataValue *value;  // Linked, so its address is not reused.
+} KnownConstant;
+
+static array(KnownConstant) known = { 0 };
+
+/// Allow folding of what a global is bound to now: a number,
+/// or a builtin function without side effects.
+void mark_constant(const Context *ctx, Symbol name)
+{
+	const Local *local = find_local(ctx, name);
+	if (local == NULL)
+		return;
+	if (known.buf == NULL)
+		init(known, 64);
+	push(KnownConstant, &known, ((KnownConstant){
+		ctx, name, link_datavalue(local->value) }));
+}
+
+/// Forget the constants of a global scope, which is being freed.
+void forget_constants(const Context *ctx)
+{
+	for (usize i = 0; i < known.len;) {
+		if (known.buf[i].ctx != ctx) {
+			++i;
+			continue;
+		}
+		unlink_datavalue(known.buf[i].value);
+		known.buf[i] = known.buf[--known.len];
+	}
+}
+
+// Bodies of at most this many nodes are substituted for calls,
+// through at most this many calls within each other.
+#define INLINE_MAX_NODES 24
+#define INLINE_MAX_DEPTH 8
+
+/// The statement being folded, and the folded nodes so far,
+/// built up in post-order like the parse arena.
+typedef struct {
+	const Context *ctx;
+	array(Symbol) bound;  // Names the statement binds anywhere.
+	array(ParseNode) out;
+	// While the body of a call is substituted for it, the
+	// parameter is replaced with the (folded) argument.
+	Symbol param;
+	const ParseNode *argument;
+	u32 depth;
+	// Within bodies of definitions and lambdas, which are kept to be
+	// evaluated later, when constants may have been rebound.
+	u32 stored;
+} Folder;
+
+typedef u32 NodeId;
+
+/// Names bound by assignments, definitions and lambdas may shadow
+/// constants, so are never folded anywhere in the statement.
+static void collect_bound(Folder *f, const ParseNode *tree)
+{
+	for (usize i = 0; i < tree->size; ++i) {
+		const ParseNode *node = tree - i;
+		if (!is_operation(node, OPR_ASSIGN) && !is_operation(node, OPR_ARROW))
+			continue;
+		const ParseNode *pattern = binary_left(node);
+		for (usize j = 0; j < pattern->size; ++j)
+			if ((pattern - j)->type == IDENT_NODE)
+				push(Symbol, &f->bound, (pattern - j)->node.ident.symbol);
+	}
+}
+
+static bool is_bound(const Folder *f, Symbol name)
+{
+	for (usize i = 0; i < f->bound.len; ++i)
+		if (f->bound.buf[i] == name)
+			return true;
+	return false;
+}
+
+/// The value of a name seen from `ctx', if it is a known constant.
+DataValue *known_constant(const Context *ctx, Symbol name)
+{
+	Local *local = search_locals(ctx, name);
+	if (local == NULL)
+		return NULL;
+	for (usize i = 0; i < known.len; ++i)
+		if (known.buf[i].name == name && known.buf[i].value == local->value)
+			return local->value;
+	return NULL;
+}
+
+static DataValue *constant_value(const Folder *f, Symbol name)
+{
+	if (f->stored > 0 || is_bound(f, name))
+		return NULL;
+	return known_constant(f->ctx, name);
+}
+
+static inline ParseNode *out_at(Folder *f, NodeId id)
+{
+	return &f->out.buf[id];
+}
+
+static NodeId emit_node(Folder *f, ParseNode node)
+{
+	push(ParseNode, &f->out, node);
+	return f->out.len - 1;
+}
+
+static NodeId emit_number(Folder *f, NumberNode num)
+{
+	return emit_node(f, (ParseNode){
+		.type = NUMBER_NODE,
+		.size = 1,
+		.node.number = num,
+	});
+}
+
+/// Copy a subtree as it is.
+static NodeId emit_tree(Folder *f, const ParseNode *tree)
+{
+	for (usize i = tree->size; i-- > 0;)
+		emit_node(f, *(tree - i));
+	return f->out.len - 1;
+}
+
+static inline bool is_number(Folder *f, NodeId id)
+{
+	return out_at(f, id)->type == NUMBER_NODE;
+}
+
+/// Replace the nodes from `start' on with the result of evaluating
+/// them, if it is a number.  Evaluation which fails is left for when
+/// the statement is executed, which will fail the same way.
+static bool fold_result(Folder *f, NodeId start, DataValue *result)
+{
+	if (result == NULL) {
+		ERROR_TYPE = NO_ERROR;
+		return false;
+	}
+	bool folded = result->type == T_NUMBER;
+	if (folded) {
+		f->out.len = start;
+		emit_number(f, result->number);
+	}
+	unlink_datavalue(result);
+	return folded;
+}
+
+static inline bool is_int(Folder *f, NodeId id, ssize value)
+{
+	const ParseNode *node = out_at(f, id);
+	return node->type == NUMBER_NODE
+		&& node->node.number.type == INT
+		&& node->node.number.value.i == value;
+}
+
+/// Type of number a folded subtree is certain to evaluate to, when it
+/// is made of numbers alone, otherwise NUMBER_TYPES.  Names could be
+/// bound to anything, so are never known to be numbers.
+static NumberType number_type(Folder *f, NodeId id)
+{
+	const ParseNode *node = out_at(f, id);
+	if (node->type == NUMBER_NODE)
+		return node->node.number.type;
+	if (node->type == UNARY_NODE) {
+		OperatorKind op = node->node.unary.op;
+		if (op != OPR_NEG && op != OPR_POS)
+			return NUMBER_TYPES;
+		return number_type(f, id - node->node.unary.operand);
+	}
+	if (node->type != BINARY_NODE)
+		return NUMBER_TYPES;
+	NumberType left = number_type(f, id - node->node.binary.left);
+	NumberType right = number_type(f, id - node->node.binary.right);
+	if (left == NUMBER_TYPES || right == NUMBER_TYPES)
+		return NUMBER_TYPES;
+	switch (node->node.binary.op) {
+	case OPR_ADD:
+	case OPR_SUB:
+	case OPR_MUL:
+		return left == INT && right == INT ? INT : FLOAT;
+	case OPR_DIV:
+		return FLOAT;
+	case OPR_CARET:
+	case OPR_STARSTAR:
+		// Integer powers may not be integers.
+		return left == INT && right == INT ? NUMBER_TYPES : FLOAT;
+	default:
+		return NUMBER_TYPES;
+	}
+}
+
+/// Whether an operation with an integer leaves the other operand as it
+/// is, on the right (`x - 0', `x * 1') or on the left (`0 + x', `1 * x').
+/// Only so when the other operand is known to be a number of the type
+/// the result would have, as strings and tuples behave otherwise.
+/// Division always gives a float, and `-0.0 + 0' gives `0.0'.
+static bool is_identity(Folder *f, OperatorKind op, NodeId literal, NodeId other, bool on_left)
+{
+	NumberType type = number_type(f, other);
+	switch (op) {
+	case OPR_ADD:
+		return is_int(f, literal, 0) && type == INT;
+	case OPR_SUB:
+		return !on_left && is_int(f, literal, 0) && type != NUMBER_TYPES;
+	case OPR_MUL:
+		return is_int(f, literal, 1) && type != NUMBER_TYPES;
+	case OPR_CARET:
+	case OPR_STARSTAR:
+		return !on_left && is_int(f, literal, 1) && type == FLOAT;
+	default:
+		return false;
+	}
+}
+
+static NodeId fold_node(Folder *, const ParseNode *);
+
+/// A body which may replace a call, with its parameter.
+typedef struct {
+	Symbol param;
+	const ParseNode *body;
+} Inlinee;
+
+/// Whether a call to the (folded) callee may be replaced with the body
+/// of the function, which must be a lambda written in place.  Functions
+/// bound to names are left to be called, since the name may be rebound
+/// before a stored body (see `stored') calls it.
+static bool find_inlinee(Folder *f, NodeId callee, NodeId operand, Inlinee *inlinee)
+{
+	if (f->depth >= INLINE_MAX_DEPTH)
+		return false;
+	const ParseNode *node = out_at(f, callee);
+	if (!is_operation(node, OPR_ARROW))
+		return false;
+	const ParseNode *pattern = binary_left(node);
+	inlinee->body = binary_right(node);
+	if (pattern->type != IDENT_NODE || inlinee->body->size > INLINE_MAX_NODES)
+		return false;
+	inlinee->param = pattern->node.ident.symbol;
+
+	usize uses = 0;
+	const ParseNode *body = inlinee->body;
+	for (usize i = 0; i < body->size; ++i) {
+		const ParseNode *part = body - i;
+		// Bindings in the body could capture names in the argument.
+		if (is_operation(part, OPR_ASSIGN) || is_operation(part, OPR_ARROW)
+		|| is_operation(part, OPR_WHERE) || is_operation(part, OPR_LET_IN))
+			return false;
+		if (part->type == IDENT_NODE && part->node.ident.symbol == inlinee->param)
+			++uses;
+	}
+	// The argument is evaluated once, unless it is as cheap as a lookup,
+	// and may only go unevaluated if doing so could not fail.
+	const ParseNode *argument = out_at(f, operand);
+	if (uses == 0)
+		return argument->type == NUMBER_NODE || argument->type == STRING_NODE;
+	return uses == 1 || argument->size == 1;
+}
+
+/// Replace the nodes from `start' on (the call) with the body,
+/// itself folded with the argument in place of the parameter.
+static NodeId inline_call(Folder *f, NodeId start, NodeId operand, const Inlinee *inlinee)
+{
+	ParseNode *argument = clone_node(out_at(f, operand));
+	ParseNode *body = clone_node(inlinee->body);
+	f->out.len = start;
+
+	Symbol param = f->param;
+	const ParseNode *outer_argument = f->argument;
+	f->param = inlinee->param;
+	f->argument = argument;
+	++f->depth;
+	NodeId root = fold_node(f, body);
+	--f->depth;
+	f->param = param;
+	f->argument = outer_argument;
+
+	free_parsenode(argument);
+	free_parsenode(body);
+	return root;
+}
+
+static NodeId fold_unary(Folder *f, const ParseNode *node)
+{
+	NodeId start = f->out.len;
+	ParseNode unary = *node;
+	OperatorKind op = node->node.unary.op;
+
+	NodeId callee = 0;
+	if (op == OPR_NONE)
+		callee = fold_node(f, unary_callee(node));
+	NodeId operand = fold_node(f, unary_operand(node));
+
+	if (is_number(f, operand)) {
+		DataValue *arg = number_data(out_at(f, operand)->node.number);
+		DataValue *result = NULL;
+		bool applied = true;
+		if (op != OPR_NONE) {
+			result = unary_operation(op, arg);
+		} else if (is_number(f, callee)) {
+			// Juxtaposition, as in `2pi'.
+			DataValue *factor = number_data(out_at(f, callee)->node.number);
+			result = apply_primitive(factor, arg);
+			unlink_datavalue(factor);
+		} else {
+			DataValue *fn = NULL;
+			if (out_at(f, callee)->type == IDENT_NODE)
+				fn = constant_value(f, out_at(f, callee)->node.ident.symbol);
+			if (fn != NULL && fn->type == T_FUNCTION_PTR)
+				result = apply_primitive(fn, arg);
+			else
+				applied = false;
+		}
+		unlink_datavalue(arg);
+		if (applied && fold_result(f, start, result))
+			return start;
+	}
+
+	Inlinee inlinee;
+	if (op == OPR_NONE && find_inlinee(f, callee, operand, &inlinee))
+		return inline_call(f, start, operand, &inlinee);
+
+	NodeId self = f->out.len;
+	unary.size = self - start + 1;
+	if (op == OPR_NONE)
+		unary.node.unary.callee = self - callee;
+	unary.node.unary.operand = self - operand;
+	return emit_node(f, unary);
+}
+
+static NodeId fold_binary(Folder *f, const ParseNode *node)
+{
+	NodeId start = f->out.len;
+	ParseNode binary = *node;
+	OperatorKind op = node->node.binary.op;
+
+	// Patterns are matched against, not evaluated.
+	NodeId lhs = op == OPR_ASSIGN || op == OPR_ARROW
+		? emit_tree(f, binary_left(node))
+		: fold_node(f, binary_left(node));
+	bool stored = op == OPR_ARROW
+		|| (op == OPR_ASSIGN && is_application(binary_left(node)));
+	f->stored += stored;
+	NodeId rhs = fold_node(f, binary_right(node));
+	f->stored -= stored;
+
+	if (is_number(f, lhs) && is_number(f, rhs)) {
+		DataValue *l = number_data(out_at(f, lhs)->node.number);
+		DataValue *r = number_data(out_at(f, rhs)->node.number);
+		DataValue *result = binary_operation(op, l, r);
+		unlink_datavalue(l);
+		unlink_datavalue(r);
+		if (fold_result(f, start, result))
+			return start;
+	}
+	if (is_identity(f, op, rhs, lhs, false)) {
+		f->out.len = rhs;
+		return lhs;
+	}
+	if (is_identity(f, op, lhs, rhs, true)) {
+		// Only the right operand remains, move it down over the literal.
+		usize size = out_at(f, rhs)->size;
+		memmove(out_at(f, start), out_at(f, rhs - size + 1),
+			size * sizeof(ParseNode));
+		f->out.len = start + size;
+		return f->out.len - 1;
+	}
+
+	NodeId self = f->out.len;
+	binary.size = self - start + 1;
+	binary.node.binary.left = self - lhs;
+	binary.node.binary.right = self - rhs;
+	return emit_node(f, binary);
+}
+
+/// Chains of (,) are folded element by element in a loop, as they are
+/// parsed (see `parse_right_chain'), so long tuples need little stack.
+static NodeId fold_tuple(Folder *f, const ParseNode *node)
+{
+	array(NodeId) elements;
+	init(elements, 8);
+	for (const ParseNode *rest = node; rest != NULL;)
+		push(NodeId, &elements, fold_node(f, next_element(&rest)));
+
+	NodeId right = elements.buf[elements.len - 1];
+	for (usize i = elements.len - 1; i-- > 0;) {
+		NodeId left = elements.buf[i];
+		NodeId start = left - out_at(f, left)->size + 1;
+		NodeId self = f->out.len;
+		ParseNode comma = *node;
+		comma.size = self - start + 1;
+		comma.node.binary.left = self - left;
+		comma.node.binary.right = self - right;
+		right = emit_node(f, comma);
+	}
+	free(elements.buf);
+	return right;
+}
+
+static NodeId fold_node(Folder *f, const ParseNode *node)
+{
+	switch (node->type) {
+	case IDENT_NODE: {
+		if (f->argument != NULL && node->node.ident.symbol == f->param)
+			return emit_tree(f, f->argument);
+		DataValue *value = constant_value(f, node->node.ident.symbol);
+		if (value != NULL && value->type == T_NUMBER)
+			return emit_number(f, value->number);
+		return emit_node(f, *node);
+	}
+	case UNARY_NODE:
+		return fold_unary(f, node);
+	case BINARY_NODE:
+		if (node->node.binary.op == OPR_COMMA)
+			return fold_tuple(f, node);
+		return fold_binary(f, node);
+	default:
+		return emit_node(f, *node);
+	}
+}
+
+/// Evaluate the parts of a statement that only depend on literals and
+/// constants (see `mark_constant'), the latter only outside of bodies
+/// of functions, which look them up when called.  Substitute the bodies
+/// of small lambdas for calls made to them in place, and drop operations
+/// which do nothing to numbers (`x * 1').  The tree given is freed, and the folded tree
+/// is returned in a block of its own.
+ParseNode *fold(const Context *ctx, ParseNode *tree)
+{
+	Folder f = { .ctx = ctx };
+	init(f.bound, 8);
+	init(f.out, tree->size);
+	collect_bound(&f, tree);
+
+	NodeId root = fold_node(&f, tree);
+	free(f.bound.buf);
+	free_parsenode(tree);
+	// Post-order, so the root is last and the tree spans the block.
+	return f.out.buf + root;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "defaults.h"
+#include "parse.h"
+#include "execute.h"
+
+/// Whether statements are folded before they are executed
+/// (on by default, see `--no-fold').
+extern bool folding;
+
+void mark_constant(const Context *, Symbol);
+void forget_constants(const Context *);
+DataValue *known_constant(const Context *, Symbol);
+ParseNode *fold(const Context *, ParseNode *);
@@ -94,6 +94,8 @@ static void button_press(GtkWidget *widget, gpointer data)
 			handle_error();
 			return;
 		}
+		if (folding)
+			tree = fold(ctx->exe_ctx, tree);
 		result = execute(ctx->exe_ctx, tree);
 		if (result == NULL || ERROR_TYPE != NO_ERROR) {
 			handle_error();
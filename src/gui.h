@@ -4,6 +4,7 @@
 #include "parse.h"
 #include "execute.h"
 #include "displays.h"
+#include "fold.h"
 
 #include <gtk/gtk.h>
 #endif
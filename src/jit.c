@@ -0,0 +1,654 @@
+#include "jit.h"
+#include "builtin.h"
+#include "fold.h"
+
+/* --- Machine code for lambdas of numbers, on x86-64 Linux --- */
+
+bool jit_enabled = false;
+
+// Lambdas which were compiled, and calls of their machine code,
+// including those handed back to the interpreter (deoptimised).
+static usize compiled = 0, refused = 0;
+static usize native_calls = 0, deopts = 0;
+
+/// Shared by every lambda which cannot be compiled.
+static Native NOT_COMPILED = { 0 };
+
+/// Code of each body compiled so far, and of which scope, for closures
+/// of it to share.  Entries go once no lambda uses them.
+static array(Native *) natives = { 0 };
+
+// The largest body compiled, in nodes, keeps frames small.
+#define JIT_MAX_NODES 256
+
+// Code which hands most calls back to the interpreter only makes them
+// slower, so is given up after this many were.
+#define DEOPT_LIMIT 64
+
+/// Only lambdas of globals, taking numbers by literal and identifier
+/// patterns, with bodies of arithmetic on numbers, are compiled.
+static bool may_compile(const Lambda *lambda)
+{
+	// Scopes of closures come and go, the constants are global.
+	if (lambda->scope == NULL || lambda->scope->superior != NULL)
+		return false;
+	const PatternTable *table = lambda->table;
+	for (usize i = 0; i < table->patterns.len; ++i) {
+		const LambdaPattern *lampat = &table->patterns.buf[i];
+		const ParseNode *pattern = lampat->pattern;
+		if (lampat->body_type != ParseNodeBody
+		||  lampat->body->size > JIT_MAX_NODES)
+			return false;
+		if (pattern->type != IDENT_NODE
+		&& (pattern->type != NUMBER_NODE || (pattern->node.number.type != INT
+		                                 &&  pattern->node.number.type != FLOAT)))
+			return false;
+	}
+	return true;
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+/* Each value computed gets a slot in the stack frame (a long double
+ * is kept in the ten bytes of a slot, an integer in its first eight),
+ * no values stay in registers from one node to the next.  Floats are
+ * long doubles, so are computed on the x87 stack, which is left empty
+ * between nodes (as calls need it to be), giving the very same results
+ * as the kernels in builtin.c.  The frame looks like:
+ *
+ *   [rbp - 8]            saved rbx, which holds the result pointer.
+ *   [rbp - 32 - 16k]     slot k, slot 0 is the argument.
+ *   [rsp], [rsp + 16]    arguments of calls (long doubles go in memory).
+ */
+
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7 };
+
+typedef s32 Slot;  // Offset from rbp.
+
+/// A number computed by the code so far, of a type known ahead of time.
+typedef struct {
+	NumberType type;
+	Slot slot;
+} Operand;
+
+/// Jumps to a place not yet known, to be patched once it is.
+typedef array(usize) Jumps;
+
+typedef struct {
+	const Lambda *lambda;
+	Native *native;  // Being compiled, holding the guards.
+	array(byte) code;
+	Jumps deopts;  // To where the code gives up.
+	bool has_param;       // Literal patterns bind nothing.
+	Symbol param;
+	NumberType param_type;
+	usize slots, max_slots;
+} Jit;
+
+static inline Slot slot_offset(usize k)
+{
+	return -32 - 16 * (Slot)k;
+}
+
+static inline void emit(Jit *j, byte b)
+{
+	push(byte, &j->code, b);
+}
+
+static void emit_u32(Jit *j, u32 word)
+{
+	for (usize i = 0; i < 4; ++i)
+		emit(j, (word >> (8 * i)) & 0xff);
+}
+
+static void emit_u64(Jit *j, u64 word)
+{
+	for (usize i = 0; i < 8; ++i)
+		emit(j, (word >> (8 * i)) & 0xff);
+}
+
+/// ModRM (and SIB) of the memory operand [base + disp32].
+static void emit_memory(Jit *j, u8 reg, u8 base, Slot disp)
+{
+	emit(j, 0x80 | (reg & 7) << 3 | (base & 7));
+	if (base == RSP)
+		emit(j, 0x24);
+	emit_u32(j, (u32)disp);
+}
+
+// mov reg, [base + disp]
+static void emit_load(Jit *j, u8 reg, u8 base, Slot disp)
+{
+	emit(j, 0x48); emit(j, 0x8b);
+	emit_memory(j, reg, base, disp);
+}
+
+// mov [base + disp], reg
+static void emit_store(Jit *j, u8 base, Slot disp, u8 reg)
+{
+	emit(j, 0x48); emit(j, 0x89);
+	emit_memory(j, reg, base, disp);
+}
+
+// mov reg, imm64
+static void emit_immediate(Jit *j, u8 reg, u64 value)
+{
+	emit(j, 0x48); emit(j, 0xb8 + reg);
+	emit_u64(j, value);
+}
+
+// fld tbyte [base + disp]
+static void emit_fld(Jit *j, u8 base, Slot disp)
+{
+	emit(j, 0xdb);
+	emit_memory(j, 5, base, disp);
+}
+
+// fstp tbyte [base + disp]
+static void emit_fstp(Jit *j, u8 base, Slot disp)
+{
+	emit(j, 0xdb);
+	emit_memory(j, 7, base, disp);
+}
+
+/// Push a number onto the x87 stack, as a float.
+static void emit_float(Jit *j, Operand operand)
+{
+	if (operand.type == FLOAT) {
+		emit_fld(j, RBP, operand.slot);
+	} else {
+		emit(j, 0xdf);  // fild qword
+		emit_memory(j, 5, RBP, operand.slot);
+	}
+}
+
+/// Call a function at a fixed address.
+static void emit_call(Jit *j, uintptr_t function)
+{
+	emit_immediate(j, RAX, function);
+	emit(j, 0xff); emit(j, 0xd0);  // call rax
+}
+
+/// Jump (`opcode' a two byte jcc, or jmp when zero) to be patched.
+static usize emit_jump(Jit *j, u8 opcode)
+{
+	if (opcode == 0) {
+		emit(j, 0xe9);
+	} else {
+		emit(j, 0x0f); emit(j, opcode);
+	}
+	emit_u32(j, 0);
+	return j->code.len;
+}
+
+/// Make the jump ending at `from' go to the end of the code so far.
+static void patch_jump(Jit *j, usize from)
+{
+	u32 rel = (u32)(j->code.len - from);
+	memcpy(&j->code.buf[from - 4], &rel, 4);
+}
+
+static Slot new_slot(Jit *j)
+{
+	Slot slot = slot_offset(j->slots++);
+	if (j->slots > j->max_slots)
+		j->max_slots = j->slots;
+	return slot;
+}
+
+static Operand emit_constant(Jit *j, NumberNode num)
+{
+	Operand out = { num.type, new_slot(j) };
+	if (num.type == INT) {
+		emit_immediate(j, RAX, (u64)num.value.i);
+		emit_store(j, RBP, out.slot, RAX);
+	} else {
+		// The ten bytes of the long double.
+		u64 low = 0;
+		u16 high = 0;
+		memcpy(&low, &num.value.f, 8);
+		memcpy(&high, (byte *)&num.value.f + 8, 2);
+		emit_immediate(j, RAX, low);
+		emit_store(j, RBP, out.slot, RAX);
+		emit_immediate(j, RAX, high);
+		emit(j, 0x66); emit(j, 0x89);  // mov word [rbp + slot + 8], ax
+		emit_memory(j, RAX, RBP, out.slot + 8);
+	}
+	return out;
+}
+
+static Operand emit_arithmetic(Jit *j, OperatorKind op, Operand lhs, Operand rhs)
+{
+	bool pow = op == OPR_CARET || op == OPR_STARSTAR;
+	Operand out = { FLOAT, new_slot(j) };
+	if (lhs.type == INT && rhs.type == INT && op != OPR_DIV) {
+		// Integers stay integers, except in division.
+		out.type = INT;
+		if (pow) {
+			emit_load(j, RDI, RBP, lhs.slot);
+			emit_load(j, RSI, RBP, rhs.slot);
+			emit_call(j, (uintptr_t)int_pow);
+		} else {
+			emit_load(j, RAX, RBP, lhs.slot);
+			emit_load(j, RCX, RBP, rhs.slot);
+			emit(j, 0x48);
+			switch (op) {
+			case OPR_ADD: emit(j, 0x01); emit(j, 0xc8); break;  // add rax, rcx
+			case OPR_SUB: emit(j, 0x29); emit(j, 0xc8); break;  // sub rax, rcx
+			default: emit(j, 0x0f); emit(j, 0xaf); emit(j, 0xc1);  // imul rax, rcx
+			}
+		}
+		emit_store(j, RBP, out.slot, RAX);
+		return out;
+	}
+	if (pow) {
+		emit_float(j, lhs);
+		emit_fstp(j, RSP, 0);
+		emit_float(j, rhs);
+		emit_fstp(j, RSP, 16);
+		emit_call(j, (uintptr_t)powl);
+	} else {
+		emit_float(j, lhs);
+		emit_float(j, rhs);
+		emit(j, 0xde);
+		switch (op) {
+		case OPR_ADD: emit(j, 0xc1); break;  // faddp
+		case OPR_SUB: emit(j, 0xe9); break;  // fsubp
+		case OPR_MUL: emit(j, 0xc9); break;  // fmulp
+		default: emit(j, 0xf9);              // fdivp
+		}
+	}
+	emit_fstp(j, RBP, out.slot);
+	return out;
+}
+
+/// The value of a global constant, built into the code on the condition
+/// that the name is still bound to it when the code is run.
+static const DataValue *guarded_constant(Jit *j, Symbol name)
+{
+	DataValue *value = known_constant(j->lambda->scope, name);
+	if (value == NULL)
+		return NULL;
+	for (usize i = 0; i < j->native->guards.len; ++i)
+		if (j->native->guards.buf[i].name == name)
+			return value;
+	push(Guard, &j->native->guards, ((Guard){
+		.name = name,
+		.value = link_datavalue(value),
+		.local = search_locals(j->lambda->scope, name),
+		.epoch = binding_epoch,
+	}));
+	return value;
+}
+
+static bool emit_node(Jit *, const ParseNode *, Operand *);
+
+/// Function application, of a math builtin, or of a number
+/// (which is multiplication).
+static bool emit_application(Jit *j, const ParseNode *node, Operand *out)
+{
+	const ParseNode *callee = unary_callee(node);
+	Operand factor, operand;
+	const DataValue *fn = NULL;
+	if (callee->type == IDENT_NODE
+	&& !(j->has_param && callee->node.ident.symbol == j->param))
+		fn = guarded_constant(j, callee->node.ident.symbol);
+
+	if (fn != NULL && fn->type == T_FUNCTION_PTR) {
+		MathFunction math = math_function(*(FnPtr *)fn->value);
+		if (math == NULL || !emit_node(j, unary_operand(node), &operand))
+			return false;
+		emit_float(j, operand);
+		emit_fstp(j, RSP, 0);
+		emit_call(j, (uintptr_t)math);
+		*out = (Operand){ FLOAT, new_slot(j) };
+		emit_fstp(j, RBP, out->slot);
+		return true;
+	}
+	if (!emit_node(j, callee, &factor)
+	||  !emit_node(j, unary_operand(node), &operand))
+		return false;
+	*out = emit_arithmetic(j, OPR_MUL, factor, operand);
+	return true;
+}
+
+/// Code computing a node, giving where the result is and its type,
+/// or false if the node is not only arithmetic on numbers.
+static bool emit_node(Jit *j, const ParseNode *node, Operand *out)
+{
+	switch (node->type) {
+	case NUMBER_NODE:
+		if (node->node.number.type != INT && node->node.number.type != FLOAT)
+			return false;
+		*out = emit_constant(j, node->node.number);
+		return true;
+	case IDENT_NODE: {
+		Symbol name = node->node.ident.symbol;
+		if (j->has_param && name == j->param) {
+			*out = (Operand){ j->param_type, slot_offset(0) };
+			return true;
+		}
+		// Free variables must be constants, such as `pi'.
+		const DataValue *value = guarded_constant(j, name);
+		if (value == NULL || value->type != T_NUMBER
+		|| (value->number.type != INT && value->number.type != FLOAT))
+			return false;
+		*out = emit_constant(j, value->number);
+		return true;
+	}
+	case UNARY_NODE: {
+		OperatorKind op = node->node.unary.op;
+		if (op == OPR_NONE)
+			return emit_application(j, node, out);
+		Operand operand;
+		if ((op != OPR_NEG && op != OPR_POS)
+		|| !emit_node(j, unary_operand(node), &operand))
+			return false;
+		if (op == OPR_POS) {
+			*out = operand;
+			return true;
+		}
+		*out = (Operand){ operand.type, new_slot(j) };
+		if (operand.type == INT) {
+			emit_load(j, RAX, RBP, operand.slot);
+			emit(j, 0x48); emit(j, 0xf7); emit(j, 0xd8);  // neg rax
+			emit_store(j, RBP, out->slot, RAX);
+		} else {
+			emit_fld(j, RBP, operand.slot);
+			emit(j, 0xd9); emit(j, 0xe0);  // fchs
+			emit_fstp(j, RBP, out->slot);
+		}
+		return true;
+	}
+	case BINARY_NODE: {
+		OperatorKind op = node->node.binary.op;
+		Operand lhs, rhs;
+		if (op != OPR_ADD && op != OPR_SUB && op != OPR_MUL && op != OPR_DIV
+		&&  op != OPR_CARET && op != OPR_STARSTAR)
+			return false;
+		if (!emit_node(j, binary_left(node), &lhs)
+		||  !emit_node(j, binary_right(node), &rhs))
+			return false;
+		*out = emit_arithmetic(j, op, lhs, rhs);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+/// Store the result of a body, and jump to the end.
+static void emit_result(Jit *j, Operand result, Jumps *done)
+{
+	if (result.type == INT) {
+		emit_load(j, RAX, RBP, result.slot);
+		emit_store(j, RBX, offsetof(NumberNode, value), RAX);
+	} else {
+		emit_fld(j, RBP, result.slot);
+		emit_fstp(j, RBX, offsetof(NumberNode, value));
+	}
+	emit(j, 0xc7);  // mov dword [rbx + type], imm32
+	emit_memory(j, 0, RBX, offsetof(NumberNode, type));
+	emit_u32(j, result.type);
+	push(usize, done, emit_jump(j, 0));
+}
+
+/// Code trying the patterns of the lambda in order, for an argument of
+/// the given type (in slot 0).  Jumps to `done' with a result.
+static bool emit_patterns(Jit *j, NumberType type, Jumps *done)
+{
+	j->param_type = type;
+	const PatternTable *table = j->lambda->table;
+	for (usize i = 0; i < table->patterns.len; ++i) {
+		const LambdaPattern *lampat = &table->patterns.buf[i];
+		const ParseNode *pattern = lampat->pattern;
+		usize skips[2], skip_count = 0;
+		j->slots = 1;
+		j->has_param = pattern->type == IDENT_NODE;
+		if (j->has_param) {
+			j->param = pattern->node.ident.symbol;
+		} else if (pattern->node.number.type != type) {
+			continue;  // Literals only match numbers of their own type.
+		} else if (type == INT) {
+			emit_load(j, RAX, RBP, slot_offset(0));
+			emit_immediate(j, RCX, (u64)pattern->node.number.value.i);
+			emit(j, 0x48); emit(j, 0x39); emit(j, 0xc8);  // cmp rax, rcx
+			skips[skip_count++] = emit_jump(j, 0x85);  // jne
+		} else {
+			Operand literal = emit_constant(j, pattern->node.number);
+			emit_fld(j, RBP, literal.slot);
+			emit_fld(j, RBP, slot_offset(0));
+			emit(j, 0xdf); emit(j, 0xe9);  // fucomip st, st(1)
+			emit(j, 0xdd); emit(j, 0xd8);  // fstp st(0)
+			skips[skip_count++] = emit_jump(j, 0x8a);  // jp, unordered
+			skips[skip_count++] = emit_jump(j, 0x85);  // jne
+		}
+
+		Operand result;
+		if (!emit_node(j, lampat->body, &result))
+			return false;
+		emit_result(j, result, done);
+		if (j->has_param)
+			return true;  // Matches anything, later patterns never do.
+		for (usize k = 0; k < skip_count; ++k)
+			patch_jump(j, skips[k]);
+	}
+	// No pattern matched, the interpreter reports it.
+	push(usize, &j->deopts, emit_jump(j, 0));
+	return true;
+}
+
+/// Copy the code into pages of its own, which are then made executable.
+static NativeCode install(const Jit *j)
+{
+	void *pages = mmap(NULL, j->code.len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED)
+		return NULL;
+	memcpy(pages, j->code.buf, j->code.len);
+	if (mprotect(pages, j->code.len, PROT_READ | PROT_EXEC) != 0) {
+		munmap(pages, j->code.len);
+		return NULL;
+	}
+	NativeCode code;
+	memcpy(&code, &pages, sizeof(code));  // Object to function pointer.
+	return code;
+}
+
+/// Compile the patterns of a lambda (see `may_compile') into the native,
+/// giving whether it could be.
+static bool compile_lambda(const Lambda *lambda, Native *native)
+{
+	Jit j = { .lambda = lambda, .native = native, .slots = 1, .max_slots = 1 };
+	Jumps done;
+	init(j.code, 512);
+	init(j.deopts, 4);
+	init(done, 4);
+
+	emit(&j, 0x55);                                // push rbp
+	emit(&j, 0x48); emit(&j, 0x89); emit(&j, 0xe5);  // mov rbp, rsp
+	emit(&j, 0x53);                                // push rbx
+	emit(&j, 0x48); emit(&j, 0x81); emit(&j, 0xec);  // sub rsp, imm32
+	emit_u32(&j, 0);
+	usize frame_size = j.code.len;
+	emit(&j, 0x48); emit(&j, 0x89); emit(&j, 0xf3);  // mov rbx, rsi
+
+	// Dispatch on the type of the argument.
+	emit(&j, 0x8b);  // mov eax, dword [rdi + type]
+	emit_memory(&j, RAX, RDI, offsetof(NumberNode, type));
+	emit(&j, 0x3d); emit_u32(&j, FLOAT);  // cmp eax, FLOAT
+	usize to_float = emit_jump(&j, 0x84);  // je
+	emit(&j, 0x3d); emit_u32(&j, INT);    // cmp eax, INT
+	push(usize, &j.deopts, emit_jump(&j, 0x85));  // jne
+
+	emit_load(&j, RAX, RDI, offsetof(NumberNode, value));
+	emit_store(&j, RBP, slot_offset(0), RAX);
+	bool ok = emit_patterns(&j, INT, &done);
+	patch_jump(&j, to_float);
+	emit_fld(&j, RDI, offsetof(NumberNode, value));
+	emit_fstp(&j, RBP, slot_offset(0));
+	ok = ok && emit_patterns(&j, FLOAT, &done);
+
+	// Give up: return false.
+	for (usize i = 0; i < j.deopts.len; ++i)
+		patch_jump(&j, j.deopts.buf[i]);
+	emit(&j, 0x31); emit(&j, 0xc0);  // xor eax, eax
+	usize to_return = emit_jump(&j, 0);
+	// Done: return true.
+	for (usize i = 0; i < done.len; ++i)
+		patch_jump(&j, done.buf[i]);
+	emit(&j, 0xb8); emit_u32(&j, 1);  // mov eax, 1
+	patch_jump(&j, to_return);
+	emit_load(&j, RBX, RBP, -8);     // mov rbx, [rbp - 8]
+	emit(&j, 0xc9);                  // leave
+	emit(&j, 0xc3);                  // ret
+
+	// Slots, the saved rbx, and 32 bytes of arguments, keeping
+	// the stack aligned to 16 bytes for calls.
+	u32 frame = 16 * j.max_slots + 40;
+	memcpy(&j.code.buf[frame_size - 4], &frame, 4);
+
+	native->code = ok ? install(&j) : NULL;
+	native->size = j.code.len;
+	free(j.code.buf);
+	free(j.deopts.buf);
+	free(done.buf);
+	return native->code != NULL;
+}
+
+static void unmap_code(Native *native)
+{
+	void *pages;
+	memcpy(&pages, &native->code, sizeof(pages));  // Function to object pointer.
+	munmap(pages, native->size);
+}
+
+#else
+
+static bool compile_lambda(const Lambda *lambda, Native *native)
+{
+	(void)lambda, (void)native;  // Only x86-64 code is generated.
+	return false;
+}
+
+static void unmap_code(Native *native)
+{
+	(void)native;  // Nothing was ever mapped.
+}
+
+#endif
+
+/// The code of a lambda, shared with its copies and other closures of
+/// the same body (the same patterns) in the same scope, compiled if
+/// there is none.
+static Native *find_native(const Lambda *lambda)
+{
+	if (!may_compile(lambda)) {
+		++refused;
+		return &NOT_COMPILED;
+	}
+	for (usize i = 0; i < natives.len; ++i) {
+		Native *native = natives.buf[i];
+		if (native->table == lambda->table
+		&&  native->scope == lambda->scope) {
+			++native->refs;
+			return native;
+		}
+	}
+	Native *native = malloc(sizeof(Native));
+	*native = (Native){
+		.refs = 1,
+		.table = link_patterns(lambda->table),
+		.scope = lambda->scope,
+	};
+	init(native->guards, 4);
+	if (compile_lambda(lambda, native))
+		++compiled;
+	else
+		++refused;
+	if (natives.buf == NULL)
+		init(natives, 16);
+	push(Native *, &natives, native);
+	return native;
+}
+
+/// Stop running the code, leaving the lambdas which share it to the
+/// interpreter from then on.
+static void retire_native(Native *native)
+{
+	if (native->code != NULL)
+		unmap_code(native);
+	native->code = NULL;
+	for (usize i = 0; i < native->guards.len; ++i)
+		unlink_datavalue(native->guards.buf[i].value);
+	native->guards.len = 0;
+}
+
+/// Whether every global built into the code is bound as it was.
+static bool guards_hold(Native *native)
+{
+	for (usize i = 0; i < native->guards.len; ++i) {
+		Guard *guard = &native->guards.buf[i];
+		if (guard->epoch != binding_epoch) {
+			// Locals may have moved.
+			guard->local = search_locals(native->scope, guard->name);
+			guard->epoch = binding_epoch;
+		}
+		if (guard->local == NULL || guard->local->value != guard->value)
+			return false;
+	}
+	return true;
+}
+
+/// A lambda no longer uses the code, which is unmapped with the last.
+void release_native(Native *native)
+{
+	if (native == &NOT_COMPILED || --native->refs > 0)
+		return;
+	retire_native(native);
+	for (usize i = 0; i < natives.len; ++i) {
+		if (natives.buf[i] == native) {
+			natives.buf[i] = natives.buf[--natives.len];
+			break;
+		}
+	}
+	unlink_patterns(native->table);
+	free(native->guards.buf);
+	free(native);
+}
+
+/// Apply the machine code of a lambda, compiling it on the first call.
+/// NULL when there is none, or it gave up, for the interpreter to call
+/// the lambda instead.
+DataValue *call_native(Lambda *lambda, const DataValue *operand)
+{
+	if (lambda->native == NULL)
+		lambda->native = find_native(lambda);
+	Native *native = lambda->native;
+	if (native->code == NULL)
+		return NULL;
+	if (!guards_hold(native)) {
+		// Rebound since, the code would give what it used to be.
+		retire_native(native);
+		++deopts;
+		return NULL;
+	}
+	++native_calls;
+	++native->calls;
+	NumberNode result;
+	if (operand->type != T_NUMBER || !native->code(&operand->number, &result)) {
+		++deopts;
+		if (++native->deopts >= DEOPT_LIMIT && 2 * native->deopts > native->calls)
+			retire_native(native);
+		return NULL;
+	}
+	return number_data(result);
+}
+
+void display_jit(FILE *file)
+{
+	fprintf(file, "%-10s %10zu lambdas %9zu refused (%zu calls, %zu deoptimised)\n",
+		"JIT", compiled, refused, native_calls, deopts);
+}
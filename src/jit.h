@@ -0,0 +1,49 @@
+#pragma once
+
+#include "defaults.h"
+#include "parse.h"
+#include "execute.h"
+
+/// Whether numeric lambdas are compiled to machine code on their
+/// first call (off by default, see `--jit').
+extern bool jit_enabled;
+
+/// Machine code computing a lambda of a number, storing the result in
+/// the second argument.  Gives false when it cannot (an argument of
+/// another type, or no pattern matched), for the interpreter to do so.
+typedef bool (*NativeCode)(const NumberNode *, NumberNode *);
+
+/// A global whose value is built into machine code, which may only
+/// run while the name is still bound to that very value.
+typedef struct {
+	Symbol name;
+	DataValue *value;      // Linked, so its address is not reused.
+	struct _local *local;  // Where it was found, until `binding_epoch' changes.
+	u64 epoch;
+} Guard;
+
+/// Machine code for the patterns of a lambda.  Closures of one body
+/// share the code, which is unmapped once no lambda uses it.
+typedef struct _native {
+	NativeCode code;  // NULL if the lambda could not be compiled.
+	usize size;       // Bytes of machine code.
+	usize refs;       // Lambdas using the code.
+	// What the code was compiled from (see `find_native').
+	struct _pattern_table *table;  // Linked, so its address is not reused.
+	const struct _context *scope;
+	array(Guard) guards;
+	usize calls, deopts;
+} Native;
+
+/// Whether a call of the lambda is worth trying in machine code.
+/// Lambdas which cannot be compiled are left to the interpreter,
+/// at the cost of no more than this check.
+static inline bool may_run_native(const Lambda *lambda)
+{
+	return jit_enabled
+		&& (lambda->native == NULL || lambda->native->code != NULL);
+}
+
+DataValue *call_native(Lambda *, const DataValue *);
+void release_native(Native *);
+void display_jit(FILE *);
@@ -15,6 +15,9 @@
 #include "parse.h"
 #include "execute.h"
 #include "displays.h"
+#include "fold.h"
+#include "jit.h"
+#include "vm.h"
 #include "gui.h"
 
 static const char *PROMPT = "::> ";
@@ -55,6 +58,8 @@ void *evaluation_thread(void *ctx_void)
 		handle_error();
 		return (void *)EXIT_FAILURE;
 	}
+	if (folding)
+		tree = fold(ctx, tree);
 
 	printf("\033[%luC\033[1A",
 		strlen(PROMPT)
@@ -73,7 +78,7 @@ void *evaluation_thread(void *ctx_void)
 	if (result != NULL) {
 		printf("#=> %s", display_datavalue(result));
 		if (debug)
-			printf("    \033[2m(%p)\033[0m", result->value);
+			printf("    \033[2m(%p)\033[0m", (void *)result);
 		printf("\n");
 		unlink_datavalue(result);
 	}
@@ -103,6 +108,10 @@ int main(int argc, char **argv)
 		else if (strcmp(argv[i], "-g") == 0
 		||       strcmp(argv[i], "--gui") == 0)
 			gui_mode = true;
+		else if (strcmp(argv[i], "--no-fold") == 0)
+			folding = false;
+		else if (strcmp(argv[i], "--jit") == 0)
+			jit_enabled = true;
 	}
 
 #ifndef GUI
@@ -166,6 +175,12 @@ int main(int argc, char **argv)
 
 	write_history(cache_loc);
 
+	if (verbose) {
+		display_pools(stdout);
+		display_caches(stdout);
+		display_jit(stdout);
+	}
+
 	printf("\r\033[2K");
 	printf("Buh-bye.\n");
 
@@ -0,0 +1,225 @@
+#include "memo.h"
+
+// Marks the end of bucket chains and of the list in order of use.
+#define NO_ENTRY UINT32_MAX
+
+Memo *make_memo(usize capacity)
+{
+	if (capacity == 0)
+		capacity = 1;
+	Memo *memo = calloc(1, sizeof(Memo));
+	memo->capacity = capacity;
+	memo->entries = malloc(sizeof(*memo->entries) * capacity);
+	usize buckets = 1;
+	while (buckets < 2 * capacity)
+		buckets *= 2;
+	memo->buckets = malloc(sizeof(u32) * buckets);
+	memset(memo->buckets, 0xff, sizeof(u32) * buckets);
+	memo->bucket_mask = buckets - 1;
+	memo->newest = memo->oldest = NO_ENTRY;
+	return memo;
+}
+
+/// Forget every result, keeping the statistics.
+void clear_memo(Memo *memo)
+{
+	for (usize i = 0; i < memo->len; ++i) {
+		unlink_datavalue(memo->entries[i].key);
+		unlink_datavalue(memo->entries[i].value);
+	}
+	memo->len = 0;
+	memset(memo->buckets, 0xff, sizeof(u32) * (memo->bucket_mask + 1));
+	memo->newest = memo->oldest = NO_ENTRY;
+}
+
+void free_memo(Memo *memo)
+{
+	clear_memo(memo);
+	free(memo->entries);
+	free(memo->buckets);
+	free(memo);
+}
+
+/// Whether every pattern body of a function leaves the scopes around
+/// it alone.  Definitions (`g x = ...') extend a function of the same
+/// name wherever it is found, globals included, so are not allowed.
+bool memoizable(const Lambda *lambda)
+{
+	const PatternTable *table = lambda->table;
+	for (usize i = 0; i < table->patterns.len; ++i) {
+		const LambdaPattern *lampat = &table->patterns.buf[i];
+		if (lampat->body_type == LambdaBody) {
+			if (!memoizable(lampat->lambda))
+				return false;
+			continue;
+		}
+		// The subtree is the `size' nodes ending at its root.
+		const ParseNode *body = lampat->body;
+		for (usize j = 0; j < body->size; ++j) {
+			const ParseNode *node = body - j;
+			if (is_operation(node, OPR_ASSIGN)
+			&& is_application(binary_left(node)))
+				return false;
+		}
+	}
+	return true;
+}
+
+/// Structural hash of a value which may be used as a key,
+/// false if it may not (functions).
+static bool hash_key(const DataValue *key, u64 *hash)
+{
+	u64 bits = 0;
+	switch (key->type) {
+	case T_NIL:
+		break;
+	case T_NUMBER:
+		if (key->number.type == INT) {
+			bits = key->number.value.i;
+		} else {
+			f64 approx = key->number.value.f;
+			memcpy(&bits, &approx, sizeof(bits));
+		}
+		bits += key->number.type;
+		break;
+	case T_STRING:
+		for (const byte *str = key->value; *str != '\0'; ++str)
+			bits = (bits ^ *str) * 1099511628211llu;  // FNV-1a.
+		break;
+	case T_TUPLE: {
+		const Tuple *tup = key->value;
+		bits = tup->length;
+		for (usize i = 0; i < tup->length; ++i) {
+			u64 item;
+			DataValue *value = tuple_item(tup, i);
+			bool hashed = hash_key(value, &item);
+			unlink_datavalue(value);
+			if (!hashed)
+				return false;
+			bits = (bits ^ item) * 1099511628211llu;
+		}
+		break;
+	}
+	default:
+		return false;
+	}
+	*hash = (bits ^ key->type) * 11400714819323198485llu;
+	return true;
+}
+
+static bool same_key(const DataValue *a, const DataValue *b)
+{
+	if (a == b)
+		return true;
+	if (a->type != b->type)
+		return false;
+	switch (a->type) {
+	case T_NIL:
+		return true;
+	case T_NUMBER:
+		if (a->number.type != b->number.type)
+			return false;
+		return a->number.type == INT
+			? a->number.value.i == b->number.value.i
+			: a->number.value.f == b->number.value.f;
+	case T_STRING:
+		return strcmp(a->value, b->value) == 0;
+	case T_TUPLE: {
+		const Tuple *p = a->value, *q = b->value;
+		if (p->length != q->length)
+			return false;
+		bool same = true;
+		for (usize i = 0; i < p->length && same; ++i) {
+			DataValue *x = tuple_item(p, i), *y = tuple_item(q, i);
+			same = same_key(x, y);
+			unlink_datavalue(x);
+			unlink_datavalue(y);
+		}
+		return same;
+	}
+	default:
+		return false;
+	}
+}
+
+static u32 find_entry(const Memo *memo, const DataValue *key, u64 hash)
+{
+	u32 i = memo->buckets[hash & memo->bucket_mask];
+	for (; i != NO_ENTRY; i = memo->entries[i].chain)
+		if (memo->entries[i].hash == hash && same_key(memo->entries[i].key, key))
+			return i;
+	return NO_ENTRY;
+}
+
+static void unlist(Memo *memo, u32 i)
+{
+	struct _memo_entry *entry = &memo->entries[i];
+	if (entry->newer == NO_ENTRY) memo->newest = entry->older;
+	else memo->entries[entry->newer].older = entry->older;
+	if (entry->older == NO_ENTRY) memo->oldest = entry->newer;
+	else memo->entries[entry->older].newer = entry->newer;
+}
+
+static void list_newest(Memo *memo, u32 i)
+{
+	struct _memo_entry *entry = &memo->entries[i];
+	entry->newer = NO_ENTRY;
+	entry->older = memo->newest;
+	if (memo->newest != NO_ENTRY)
+		memo->entries[memo->newest].newer = i;
+	memo->newest = i;
+	if (memo->oldest == NO_ENTRY)
+		memo->oldest = i;
+}
+
+static void unchain(Memo *memo, u32 i)
+{
+	u32 *link = &memo->buckets[memo->entries[i].hash & memo->bucket_mask];
+	while (*link != i)
+		link = &memo->entries[*link].chain;
+	*link = memo->entries[i].chain;
+}
+
+/// Remembered result for an argument, borrowed, or NULL.
+DataValue *memo_lookup(Memo *memo, const DataValue *key)
+{
+	u64 hash;
+	if (!hash_key(key, &hash))
+		return NULL;
+	u32 i = find_entry(memo, key, hash);
+	if (i == NO_ENTRY) {
+		++memo->misses;
+		return NULL;
+	}
+	++memo->hits;
+	unlist(memo, i);
+	list_newest(memo, i);
+	return memo->entries[i].value;
+}
+
+/// Remember the result for an argument, evicting the least recently
+/// used result if full.  Neither are unlinked.
+void memo_store(Memo *memo, DataValue *key, DataValue *value)
+{
+	u64 hash;
+	if (!hash_key(key, &hash) || find_entry(memo, key, hash) != NO_ENTRY)
+		return;
+	u32 i;
+	if (memo->len < memo->capacity) {
+		i = memo->len++;
+	} else {
+		i = memo->oldest;
+		unlist(memo, i);
+		unchain(memo, i);
+		unlink_datavalue(memo->entries[i].key);
+		unlink_datavalue(memo->entries[i].value);
+	}
+	struct _memo_entry *entry = &memo->entries[i];
+	entry->key = link_datavalue(key);
+	entry->value = link_datavalue(value);
+	entry->hash = hash;
+	u32 *bucket = &memo->buckets[hash & memo->bucket_mask];
+	entry->chain = *bucket;
+	*bucket = i;
+	list_newest(memo, i);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "defaults.h"
+#include "execute.h"
+
+#define MEMO_DEFAULT_CAPACITY 4096
+// Entries are allocated up front, and counted in 32 bits.
+#define MEMO_MAX_CAPACITY (1 << 20)
+
+/// Results of a function, by argument, of which at most `capacity'
+/// are kept, the least recently used being evicted first.
+/// Entries link their key and value, so neither can change.
+typedef struct _memo {
+	usize capacity;
+	usize len;
+	struct _memo_entry {
+		DataValue *key;
+		DataValue *value;
+		u64 hash;
+		u32 chain;       // Next entry in the same bucket.
+		u32 newer, older;
+	} *entries;
+	u32 *buckets;        // Index of first entry in chain.
+	usize bucket_mask;
+	u32 newest, oldest;  // Ends of the list in order of use.
+	usize hits;
+	usize misses;
+} Memo;
+
+Memo *make_memo(usize);
+void clear_memo(Memo *);
+void free_memo(Memo *);
+bool memoizable(const Lambda *);
+DataValue *memo_lookup(Memo *, const DataValue *);
+void memo_store(Memo *, DataValue *, DataValue *);
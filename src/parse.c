@@ -6,78 +6,34 @@
 #include "displays.h"
 #include "parse.h"
 
-void free_token(Token *token)
+/// Textual representation of an operator.
+const char *operator_name(OperatorKind kind)
 {
-	free((char *)token->value);
-	free(token);
+	if (kind == OPR_LET_IN)
+		return "let-in";
+	for (usize i = 0; i < len(KNOWN_OPERATORS); ++i)
+		if (KNOWN_OPERATORS[i].kind == kind)
+			return KNOWN_OPERATORS[i].value;
+	return "<unknown-operator>";
 }
 
+/// Free a whole tree, as returned by `parse' or `clone_node'.
 void free_parsenode(ParseNode *node)
 {
-	switch (node->type) {
-	case IDENT_NODE:
-		free((char *)node->node.ident.value);
-		break;
-	case STRING_NODE:
-		free((char *)node->node.str.value);
-		break;
-	case NUMBER_NODE:
-		break;
-	case UNARY_NODE:
-		free_parsenode((ParseNode *)node->node.unary.callee);
-		free_parsenode((ParseNode *)node->node.unary.operand);
-		break;
-	case BINARY_NODE:
-		free_parsenode((ParseNode *)node->node.binary.callee);
-		free_parsenode((ParseNode *)node->node.binary.left);
-		free_parsenode((ParseNode *)node->node.binary.right);
-		break;
-	default:
-		fprintf(stderr, "unhandled node: %d\n", node->type);
-		exit(2);
-	}
-	free(node);
+	free(node - node->size + 1);
 }
 
+/// Copy a subtree into its own block.  Children are relative and
+/// strings are interned, so this is a single copy.
 ParseNode *clone_node(const ParseNode *node)
 {
-	ParseNode *new = malloc(sizeof(ParseNode));
-	*new = *node;
-	switch (node->type) {
-	case IDENT_NODE:
-		new->node.ident.value = strdup(node->node.ident.value);
-		break;
-	case STRING_NODE:
-		new->node.str.value = strdup(node->node.str.value);
-		break;
-	case NUMBER_NODE:
-		break;
-	case UNARY_NODE:
-		new->node.unary.callee = clone_node(node->node.unary.callee);
-		new->node.unary.operand = clone_node(node->node.unary.operand);
-		break;
-	case BINARY_NODE:
-		new->node.binary.callee = clone_node(node->node.binary.callee);
-		new->node.binary.left = clone_node(node->node.binary.left);
-		new->node.binary.right = clone_node(node->node.binary.right);
-		break;
-	default:
-		fprintf(stderr, "unhandled node: %d\n", node->type);
-		exit(2);
-	}
-	return new;
+	ParseNode *block = malloc(node->size * sizeof(ParseNode));
+	memcpy(block, node - node->size + 1, node->size * sizeof(ParseNode));
+	return block + node->size - 1;
 }
 
 /* --- Functions related to tokenising/lexing --- */
 
-Token *new_token(TokenType type, const char *value)
-{
-	Token *t = malloc(sizeof(Token));
-	t->type  = type;
-	t->value = strdup(value);
-	return t;
-}
-
 TokenType char_token_type(char c, char last_char, TokenType last_token_type)
 {
 	if (c <= '9' && c >= '0') {
@@ -120,107 +76,173 @@ TokenType char_token_type(char c, char last_char, TokenType last_token_type)
 	return TT_IDENTIFIER;
 }
 
-/// Returns a token matching in the source, and increments the
-/// pointer to point after the match.  This function is to be
-/// applied repeatedly until the source is empty (NULL).
-/// NOTE: Return of NULL means EOF or an Error was found.
-/// NOTE: `source' is a pointer to a pointer, so that the
-///       character `source' is pointing to can be offset.
-Token *lex(char **source)
+/// Split all of `source' into `stream'.  Tokens only refer to
+/// their text by offset and length, so nothing is copied, and
+/// the token buffer of the stream is reused between calls.
+/// Returns false (with ERROR_TYPE set) on a syntax error.
+bool lex(const char *source, TokenStream *stream)
 {
-	if (**source == '\0')
-		return NULL;  // No more tokens.
-
-	TokenType tt = char_token_type(**source, ' ', TT_NONE);
-
-	// Skip over TT_NONE tokens (spaces, tabs, etc.).
-	while (tt == TT_NONE) {
-		(*source)++;
-		if (**source == '\0')
-			return NULL;
-		tt = char_token_type(**source, *(*source - 1), tt);
-	}
-
-	// First of all, check if it matches an operator.
-	for (usize i = 0; i < len(KNOWN_OPERATORS); ++i) {
-		const char *operator = KNOWN_OPERATORS[i].value;
-		usize operator_len = strlen(operator);
-
-		if (strncmp(*source, operator, operator_len) == 0) {
-			Token *token = new_token(TT_OPERATOR, operator);
-			*source += operator_len;
-			return token;
+	stream->source = source;
+	stream->tokens.len = 0;
+	stream->next = 0;
+	if (stream->tokens.buf == NULL)
+		init(stream->tokens, 64);
+
+	usize pos = 0;
+	for (;;) {
+		if (source[pos] == '\0')
+			return true;  // No more tokens.
+
+		TokenType tt = char_token_type(source[pos], ' ', TT_NONE);
+
+		// Skip over TT_NONE tokens (spaces, tabs, etc.).
+		while (tt == TT_NONE) {
+			pos++;
+			if (source[pos] == '\0')
+				return true;
+			tt = char_token_type(source[pos], source[pos - 1], tt);
 		}
-	}
 
-	// If we match an operator-type character, and it wasn't
-	// found in our for-loop, it means it is an unknown operator,
-	// and we should report it as an error.
-	if (tt == TT_OPERATOR) {
-		ERROR_TYPE = SYNTAX_ERROR;
-		sprintf(ERROR_MSG, "Operator `%c' does not exist.", **source);
-		return NULL;
-	}
+		Token token = {
+			.type = tt,
+			.offset = pos,
+			.len = 0,
+			.prefix = NULL,
+			.infix = NULL,
+		};
 
-	// Now, we check the type of the current character,
-	// then we check the next character, if the type is the same
-	// we continue collecting the characters until the type is no longer
-	// the same, and we return the token.
-
-	// That's to say, characters of the same `kind' coalesce.
-	TokenType previous_tt = tt;
-	usize span = 0;
-
-	// Do not coalesce parentheses.
-	if (tt == TT_RPAREN || tt == TT_LPAREN) {
-		span++;
-	} else if (tt == TT_STRING) {  // String literals are not like others.
-		++span;  // Skip opening quote.
-		while ((*source)[span] != '"') {
-			if ((*source)[span] == '\\' && (*source)[span + 1] == '"')
-				++span;  // Don't stop at escaped quote.
-			++span;
+		// First of all, check if it matches an operator.
+		for (usize i = 0; i < len(KNOWN_OPERATORS); ++i) {
+			const char *operator = KNOWN_OPERATORS[i].value;
+			usize operator_len = strlen(operator);
+
+			if (strncmp(source + pos, operator, operator_len) != 0)
+				continue;
+			token.type = TT_OPERATOR;
+			token.len = operator_len;
+			// Resolve the operator in each position now, so the
+			// parser never has to compare operator names.
+			for (usize j = i; j < len(KNOWN_OPERATORS); ++j) {
+				const Operator *op = &KNOWN_OPERATORS[j];
+				if (strcmp(operator, op->value) != 0)
+					continue;
+				if (op->fixity == PREFIX && token.prefix == NULL)
+					token.prefix = op;
+				else if (op->fixity != PREFIX && token.infix == NULL)
+					token.infix = op;
+			}
+			break;
 		}
-		++span;  // Skip ending quote.
-	} else {
-		while (tt == previous_tt) {
-			span++;
-			previous_tt = char_token_type(
-				*(*source + span),
-				*(*source + span - (span == 0 ? 0 : 1)),
-				previous_tt);
+
+		if (token.type == TT_OPERATOR && token.len == 0) {
+			// If we match an operator-type character, and it wasn't
+			// found in our for-loop, it means it is an unknown operator,
+			// and we should report it as an error.
+			ERROR_TYPE = SYNTAX_ERROR;
+			sprintf(ERROR_MSG, "Operator `%c' does not exist.", source[pos]);
+			return false;
+		} else if (tt == TT_RPAREN || tt == TT_LPAREN) {
+			// Do not coalesce parentheses.
+			token.len = 1;
+		} else if (tt == TT_STRING) {  // String literals are not like others.
+			usize span = 1;  // Skip opening quote.
+			while (source[pos + span] != '"') {
+				if (source[pos + span] == '\0') {
+					ERROR_TYPE = SYNTAX_ERROR;
+					strcpy(ERROR_MSG, "Unterminated string literal.");
+					return false;
+				}
+				if (source[pos + span] == '\\' && source[pos + span + 1] == '"')
+					++span;  // Don't stop at escaped quote.
+				++span;
+			}
+			token.len = span + 1;  // Skip ending quote.
+		} else if (token.len == 0) {
+			// Now, we check the type of the current character,
+			// then we check the next character, if the type is the same
+			// we continue collecting the characters until the type is no
+			// longer the same.
+
+			// That's to say, characters of the same `kind' coalesce.
+			TokenType previous_tt = tt;
+			usize span = 0;
+			while (tt == previous_tt) {
+				span++;
+				previous_tt = char_token_type(
+					source[pos + span],
+					source[pos + span - 1],
+					previous_tt);
+			}
+			token.len = span;
 		}
-	}
 
-	char *sub_str = malloc(span * sizeof(char));
-	strncpy(sub_str, *source, span);
-	sub_str[span] = '\0';
+		push(Token, &stream->tokens, token);
+		pos += token.len;
+	}
+}
 
-	*source += span;
-	Token *token = new_token(tt, sub_str);
+/// The next token, without consuming it, or NULL at the end.
+const Token *peek(const TokenStream *stream)
+{
+	if (stream->next >= stream->tokens.len)
+		return NULL;
+	return &stream->tokens.buf[stream->next];
+}
 
-	free(sub_str);
+/// Consume the next token, or NULL at the end.
+const Token *next_token(TokenStream *stream)
+{
+	const Token *token = peek(stream);
+	if (token != NULL)
+		stream->next++;
 	return token;
 }
 
-Token *peek(char **source)
+/// Whether a token is spelt exactly as `text'.
+static bool token_is(const TokenStream *stream, const Token *token, const char *text)
 {
-	char *original = *source;
-	Token *token = lex(source);
-	*source = original;
-	return token;
+	return strncmp(stream->source + token->offset, text, token->len) == 0
+		&& text[token->len] == '\0';
 }
 
+// Arguments for printing the text of a token with "%.*s".
+#define TOKEN_TEXT(STREAM, TOKEN) \
+	(int)(TOKEN)->len, (STREAM)->source + (TOKEN)->offset
+
 /* --- Functions related to parsing into a tree --- */
 
-void node_into_ident(const char *str, ParseNode *node)
+/// Index of a node in the parse arena.
+typedef u32 NodeId;
+#define NO_NODE ((NodeId)-1)
+
+// Nodes of the statement being parsed.  Children are always
+// complete before their parent, so the arena fills in post-order.
+static array(ParseNode) arena = { 0 };
+
+static inline ParseNode *arena_at(NodeId id)
 {
-	IdentNode *ident = malloc(sizeof(IdentNode));
-	ident->value = strdup(str);
-	node->type = IDENT_NODE;
-	node->node.ident = *ident;
+	return &arena.buf[id];
 }
 
+/// Append a node to the arena.  Pointers into the arena are
+/// invalidated by this, hence nodes are referred to by index.
+static NodeId new_node(NodeType type)
+{
+	if (arena.buf == NULL)
+		init(arena, 64);
+	push(ParseNode, &arena, ((ParseNode){ .type = type, .size = 1 }));
+	return arena.len - 1;
+}
+
+/// Attach `child' to `parent', returning the reference to it.
+static NodeRef adopt(NodeId parent, NodeId child)
+{
+	arena_at(parent)->size += arena_at(child)->size;
+	return parent - child;
+}
+
+static NodeId parse_expr(TokenStream *, iprec);
+
 NumberNode *make_number(NumberType type, void *val)
 {
 	NumberNode *num = malloc(sizeof(NumberNode));
@@ -246,12 +268,18 @@ NumberNode *make_number(NumberType type, void *val)
 // e.g. 3, 8.2, 2E32, 3E+4, 1.6E-19, 0b010110, 0xff32a1, 0o0774, etc.
 // TODO: Parse binary, hexadecimal and octal literals (0b, 0x, 0o)
 //       as well as hex/binary `P' power notation..
-NumberNode *parse_number(const char *str)
+bool parse_number(const char *literal, usize len, NumberNode *number)
 {
-	NumberNode *number = malloc(sizeof(NumberNode));
-
-	str = remove_all_bytes(str, '_');
-
+	// Strip digit separators into a local copy, which only
+	// needs to be allocated for unusually long literals.
+	char buffer[64];
+	char *str = len < sizeof(buffer) ? buffer : malloc(len + 1);
+	usize str_len = 0;
+	for (usize i = 0; i < len; ++i)
+		if (literal[i] != '_') str[str_len++] = literal[i];
+	str[str_len] = '\0';
+
+	bool valid = false;
 	char *exponent_ptr = strstr(str, "E");
 	char *neg_exponent_ptr = strstr(str, "E-");
 	char *decimal_point_ptr = strstr(str, ".");
@@ -260,25 +288,26 @@ NumberNode *parse_number(const char *str)
 	if (exponent_ptr != NULL) {
 		// No trailing 'E'.
 		if (*(exponent_ptr + 1) == '\0')
-			return NULL;
+			goto done;
 		// No trailing 'E+' or 'E-'.
 		if ((*(exponent_ptr + 1) == '+'
 		||   *(exponent_ptr + 1) == '-')
 		&&   *(exponent_ptr + 2) == '\0')
-			return NULL;
+			goto done;
 		// No repreated 'E' and no decimal point ('.') after 'E'.
 		if (strstr(exponent_ptr + 1, "E") != NULL
 		||  strstr(exponent_ptr + 1, ".") != NULL)
-			return NULL;
+			goto done;
 	}
 	if (decimal_point_ptr != NULL) {
 		// No trailing decimal point ('.').
 		if (*(decimal_point_ptr + 1) == '\0')
-			return NULL;
+			goto done;
 		// No decimal point ('.') after first decimal point.
 		if (strstr(decimal_point_ptr + 1, ".") != NULL)
-			return NULL;
+			goto done;
 	}
+	valid = true;
 
 	// No negative exponent and no decimal point, means
 	// the number literal is certainly an integer.
@@ -287,15 +316,14 @@ NumberNode *parse_number(const char *str)
 		ssize significand = strtoll(str, NULL, 0);
 		if (exponent_ptr == NULL) { // No power-term.
 			number->value.i = significand;
-			return number;
+			goto done;
 		}
 
 		usize exponent = strtoull(exponent_ptr + 1, NULL, 10);
-		ssize power_term = ipow(10, exponent);
-		if (power_term >= 0 && exponent <= 18) {
-			// Probably didn't overflow.
-			number->value.i = significand * power_term;
-			return number;
+		if (exponent <= 18) {
+			// Probably doesn't overflow.
+			number->value.i = significand * ipow(10, exponent);
+			goto done;
 		}
 		// Fallback to float.
 	}
@@ -303,319 +331,325 @@ NumberNode *parse_number(const char *str)
 	number->type = FLOAT;
 	number->value.f = strtold(str, NULL);
 
-	return number;
+done:
+	if (str != buffer)
+		free(str);
+	return valid;
 }
 
-ParseNode *parse_prefix(const Token *token, char **rest)
+static NodeId parse_prefix(const Token *token, TokenStream *ts)
 {
-	ParseNode *node = malloc(sizeof(ParseNode));
+	NodeId node = NO_NODE;
 
 	switch (token->type) {
 	case TT_NUMERIC: {
-		NumberNode *num = parse_number(token->value);
-		if (num == NULL) {
+		NumberNode num;
+		if (!parse_number(ts->source + token->offset, token->len, &num)) {
 			ERROR_TYPE = SYNTAX_ERROR;
-			sprintf(ERROR_MSG, "Malformed number literal (`%s').",
-				token->value);
-			return NULL;
+			sprintf(ERROR_MSG, "Malformed number literal (`%.*s').",
+				TOKEN_TEXT(ts, token));
+			return NO_NODE;
 		}
 
-		node->type = NUMBER_NODE;
-		node->node.number = *num;
+		node = new_node(NUMBER_NODE);
+		arena_at(node)->node.number = num;
 		break;
 	}
 	case TT_IDENTIFIER: {
 		// Parse `let`-`in` expressions.
-		if (strcmp(token->value, "let") == 0) {
-			ParseNode *bindings = parse_expr(rest, min_prec);
-			if (bindings == NULL) {
+		if (token_is(ts, token, "let")) {
+			NodeId bindings = parse_expr(ts, min_prec);
+			if (bindings == NO_NODE) {
 				ERROR_TYPE = PARSE_ERROR;
 				sprintf(ERROR_MSG, "Missing bindings in let-in expression.");
-				return NULL;
+				return NO_NODE;
 			}
-			token = lex(rest);
-			if (token == NULL || strcmp(token->value, "in") != 0) {
+			token = next_token(ts);
+			if (token == NULL || !token_is(ts, token, "in")) {
 				ERROR_TYPE = PARSE_ERROR;
 				sprintf(ERROR_MSG, "Unfinished `let ... in ...` expression. Missing `in`.");
-				return NULL;
+				return NO_NODE;
 			}
-			ParseNode *expr = parse_expr(rest, min_prec);
-			if (expr == NULL) {
+			NodeId expr = parse_expr(ts, min_prec);
+			if (expr == NO_NODE) {
 				ERROR_TYPE = PARSE_ERROR;
 				sprintf(ERROR_MSG, "Missing result in let-in expression.");
-				return NULL;
+				return NO_NODE;
 			}
-			node->type = BINARY_NODE;
-			ParseNode *callee = malloc(sizeof(ParseNode));
-			callee->type = IDENT_NODE;
-			callee->node.ident = (IdentNode){ .value = strdup("let-in") };
-			node->node.binary.callee = callee;
-			node->node.binary.left = bindings;
-			node->node.binary.right = expr;
+			node = new_node(BINARY_NODE);
+			arena_at(node)->node.binary.op = OPR_LET_IN;
+			arena_at(node)->node.binary.left = adopt(node, bindings);
+			arena_at(node)->node.binary.right = adopt(node, expr);
 			break;
 		}
 		// Otherwise, just produce an ident.
-		node_into_ident(token->value, node);
+		node = new_node(IDENT_NODE);
+		arena_at(node)->node.ident.symbol =
+			intern_symbol(ts->source + token->offset, token->len);
 		break;
 	}
 	case TT_STRING: {
-		node->type = STRING_NODE;  // TODO: Parse string escapes etc.
-		node->node.str.value = strdup(token->value + 1);
-		node->node.str.len = strlen(token->value) - 2;
-		node->node.str.value[node->node.str.len] = '\0';
+		node = new_node(STRING_NODE);  // TODO: Parse string escapes etc.
+		StringNode *str = &arena_at(node)->node.str;
+		str->len = token->len - 2;
+		str->value = (const byte *)intern(ts->source + token->offset + 1, str->len);
 		break;
 	}
 	case TT_OPERATOR: {
 		// Verify this is a prefix operator.
-		bool is_prefix = false;
-		iprec precedence = min_prec;
-		for (usize i = 0; i < len(KNOWN_OPERATORS); ++i) {
-			Operator op = KNOWN_OPERATORS[i];
-			if (strcmp(token->value, op.value) == 0 && op.fixity == PREFIX) {
-				is_prefix = true;
-				precedence = op.precedence;
-				break;
-			}
-		}
-		if (!is_prefix) {
+		const Operator *prefix = token->prefix;
+		if (prefix == NULL) {
 			ERROR_TYPE = PARSE_ERROR;
 			sprintf(ERROR_MSG,
-				"`%s' operator cannot be used as a prefix.\n"
-				"  Missing left-hand-side argument of `%s' operator.",
-				token->value, token->value);
-			return NULL;
+				"`%.*s' operator cannot be used as a prefix.\n"
+				"  Missing left-hand-side argument of `%.*s' operator.",
+				TOKEN_TEXT(ts, token), TOKEN_TEXT(ts, token));
+			return NO_NODE;
 		}
 
-		UnaryNode *unary = malloc(sizeof(UnaryNode));
-		ParseNode *callee = malloc(sizeof(ParseNode));
-		node_into_ident(token->value, callee);
-
-		unary->callee = callee;
-		unary->operand = parse_expr(rest, precedence);
-		if (unary->operand == NULL) {
+		NodeId operand = parse_expr(ts, prefix->precedence);
+		if (operand == NO_NODE) {
 			ERROR_TYPE = PARSE_ERROR;
 			sprintf(ERROR_MSG, "Missing right-hand-side of prefix"
-				" operator `%s'.", token->value);
-			return NULL;
+				" operator `%.*s'.", TOKEN_TEXT(ts, token));
+			return NO_NODE;
 		}
-		unary->is_postfix = false;
-
-		node->type = UNARY_NODE;
-		node->node.unary = *unary;
 
+		node = new_node(UNARY_NODE);
+		UnaryNode *unary = &arena_at(node)->node.unary;
+		unary->op = prefix->kind;
+		unary->operand = adopt(node, operand);
+		unary->is_postfix = false;
 		break;
 	}
 	case TT_LPAREN: {
-		node = parse_expr(rest, min_prec);
-		token = lex(rest);
+		node = parse_expr(ts, min_prec);
+		token = next_token(ts);
 		if (token == NULL || token->type != TT_RPAREN) {
 			ERROR_TYPE = PARSE_ERROR;
 			sprintf(ERROR_MSG, "Unclosed paranthetical expression.\n"
 				"  Missing `)' closing parenthesis.");
-			return NULL;
+			return NO_NODE;
 		}
-		free_token((Token *)token);
 		break;
 	}
 	default:
-		return NULL;
+		return NO_NODE;
 	}
 
 	return node;
 }
 
-iprec token_precedence(Token *token)
+static iprec token_precedence(const TokenStream *ts, const Token *token)
 {
 	// Check if its an `)'.
 	if (token->type == TT_RPAREN)
 		return 0;
-	if (token->type == TT_IDENTIFIER && strcmp(token->value, "in") == 0) {
+	if (token->type == TT_IDENTIFIER && token_is(ts, token, "in")) {
 		return 0;
 	}
 	// Check if its an operator.
-	for (usize i = 0; i < len(KNOWN_OPERATORS); ++i) {
-		Operator op = KNOWN_OPERATORS[i];
-		if (strcmp(token->value, op.value) == 0
-		&& (op.fixity == INFIX || op.fixity == POSTFIX)) {
-			return op.precedence;
-		}
-	}
+	if (token->infix != NULL)
+		return token->infix->precedence;
 	// Otherwise, assume it's a function application.
 	return FUNCTION_PRECEDENCE;
 }
 
-ParseNode *parse_infix(const ParseNode *left,
-	const Token *token,
-	char **rest, iprec last_precedence)
+static void missing_operand(const TokenStream *ts, const Token *token)
 {
-	bool is_postfix = false;
-	bool is_operator = false;
-	iprec precedence = min_prec;
-	Associativity assoc = NEITHER_ASSOC;
+	ERROR_TYPE = PARSE_ERROR;
+	sprintf(ERROR_MSG,
+		"Attempted to use `%.*s' infix-operator as a suffix.\n"
+		"  Missing right-hand-side argument of `%.*s' operator.",
+		TOKEN_TEXT(ts, token), TOKEN_TEXT(ts, token));
+}
 
-	// Extract information on operator (if operator at all)
-	for (usize i = 0; i < len(KNOWN_OPERATORS); ++i) {
-		Operator op = KNOWN_OPERATORS[i];
-		if (strcmp(token->value, op.value) == 0) {
-			is_operator = true;
-			precedence = op.precedence;
-			assoc = op.assoc;
-			if (op.fixity == POSTFIX) {
-				is_postfix = true;
-				break;
-			}
+/// Parse `a , b , ... , z' for right associative operators of equal
+/// precedence, as (a , (b , (... , z))).  The operands are parsed in a
+/// loop rather than by recursion, so long tuples do not run out of
+/// stack, and the tree is then joined up from the right.
+static NodeId parse_right_chain(NodeId left, const Token *token, TokenStream *ts)
+{
+	const Operator *infix = token->infix;
+	array(NodeId) operands;
+	array(OperatorKind) ops;
+	init(operands, 8);
+	init(ops, 8);
+	push(NodeId, &operands, left);
+	for (;;) {
+		push(OperatorKind, &ops, infix->kind);
+		NodeId right = parse_expr(ts, infix->precedence);
+		if (right == NO_NODE) {
+			missing_operand(ts, token);
+			free(operands.buf);
+			free(ops.buf);
+			return NO_NODE;
 		}
+		push(NodeId, &operands, right);
+		token = peek(ts);
+		if (token == NULL || token->infix == NULL
+		||  token->infix->assoc != RIGHT_ASSOC
+		||  token->infix->precedence != infix->precedence)
+			break;
+		infix = next_token(ts)->infix;
 	}
 
-	// Function calls and post fix operators share some common code.
-	if (is_postfix || !is_operator) {
-		UnaryNode *unary = malloc(sizeof(UnaryNode));
-
-		if (is_postfix) { // Postfix operator.
-			ParseNode *node = malloc(sizeof(ParseNode));
-			node_into_ident(token->value, node);
-			unary->callee = node;
-			unary->operand = left;
-			unary->is_postfix = true;
-		} else { // Function call, probably.
-			if (token->type == TT_OPERATOR)
-				return NULL; // Not a real operator, not a function.
-
-			unary->callee = left;
-			// The minus one (- 1) makes function application right
-			// associative, this is unconventional, and makes applications
-			// on functions that return functions not very pretty.
-			// However, it makes for more natural syntax for multiplication
-			// by juxtaposition.
-			// e.g.  3 sin 2  =>  (3 (sin 2)) vs ((3 sin) 2)  [<- error]
-			unary->operand = parse_expr(rest, FUNCTION_PRECEDENCE - 1);
-			if (unary->operand == NULL)
-				return NULL;
-			unary->is_postfix = false;
-		}
+	NodeId node = operands.buf[operands.len - 1];
+	for (usize i = ops.len; i-- > 0;) {
+		NodeId parent = new_node(BINARY_NODE);
+		BinaryNode *binary = &arena_at(parent)->node.binary;
+		binary->op = ops.buf[i];
+		binary->left = adopt(parent, operands.buf[i]);
+		binary->right = adopt(parent, node);
+		node = parent;
+	}
+	free(operands.buf);
+	free(ops.buf);
+	return node;
+}
 
-		ParseNode *node = malloc(sizeof(ParseNode));
-		node->type = UNARY_NODE;
-		node->node.unary = *unary;
+static NodeId parse_infix(NodeId left,
+	const Token *token,
+	TokenStream *ts, iprec last_precedence)
+{
+	// Extract information on operator (if operator at all)
+	const Operator *infix = token->infix;
+	bool is_operator = infix != NULL;
+	bool is_postfix = infix != NULL && infix->fixity == POSTFIX;
+	iprec precedence = infix == NULL ? min_prec : infix->precedence;
+	Associativity assoc = infix == NULL ? NEITHER_ASSOC : infix->assoc;
+
+	// Postfix operator.
+	if (is_postfix) {
+		NodeId node = new_node(UNARY_NODE);
+		UnaryNode *unary = &arena_at(node)->node.unary;
+		unary->op = infix->kind;
+		unary->operand = adopt(node, left);
+		unary->is_postfix = true;
+		return node;
+	}
 
+	// Function call, probably.
+	if (!is_operator) {
+		if (token->type == TT_OPERATOR) {
+			// Not a real operator, not a function.
+			ERROR_TYPE = PARSE_ERROR;
+			sprintf(ERROR_MSG, "`%.*s' operator cannot be used"
+				" as an infix or postfix.", TOKEN_TEXT(ts, token));
+			return NO_NODE;
+		}
+
+		// The minus one (- 1) makes function application right
+		// associative, this is unconventional, and makes applications
+		// on functions that return functions not very pretty.
+		// However, it makes for more natural syntax for multiplication
+		// by juxtaposition.
+		// e.g.  3 sin 2  =>  (3 (sin 2)) vs ((3 sin) 2)  [<- error]
+		NodeId operand = parse_expr(ts, FUNCTION_PRECEDENCE - 1);
+		if (operand == NO_NODE)
+			return NO_NODE;
+
+		NodeId node = new_node(UNARY_NODE);
+		UnaryNode *unary = &arena_at(node)->node.unary;
+		unary->op = OPR_NONE;
+		unary->callee = adopt(node, left);
+		unary->operand = adopt(node, operand);
+		unary->is_postfix = false;
 		return node;
 	}
 
-	// Trick for right associativity is to pretend that what's
-	// to the left of you is slightly higher precedence.
 	if (assoc == RIGHT_ASSOC)
-		precedence -= 1;
+		return parse_right_chain(left, token, ts);
 
 	// Don't allow chaining of operators with no
 	// left or right associativity.
 	if (assoc == NEITHER_ASSOC && precedence == last_precedence) {
 		ERROR_TYPE = PARSE_ERROR;
-		sprintf(ERROR_MSG, "Operator `%s' cannot be chained with\n"
+		sprintf(ERROR_MSG, "Operator `%.*s' cannot be chained with\n"
 			"  operators of equal precedence, please use parentheses.",
-			token->value);
-		return NULL;
+			TOKEN_TEXT(ts, token));
+		return NO_NODE;
 	}
 
 	// Binary operator:
-
-	// Call node.
-	ParseNode *callee = malloc(sizeof(ParseNode));
-	node_into_ident(token->value, callee);
-
-	// Root binary node.
-	ParseNode *binary_node = malloc(sizeof(ParseNode));
-	BinaryNode *binary = malloc(sizeof(BinaryNode));
-
-	// Populate binary struct.
-	binary->callee = callee;
-	binary->left = left;
-	binary->right = parse_expr(rest, precedence);
-
-	if (binary->right == NULL) {
-		ERROR_TYPE = PARSE_ERROR;
-		sprintf(ERROR_MSG,
-			"Attempted to use `%s' infix-operator as a suffix.\n"
-			"  Missing right-hand-side argument of `%s' operator.",
-			token->value, token->value);
-		return NULL;
+	NodeId right = parse_expr(ts, precedence);
+	if (right == NO_NODE) {
+		missing_operand(ts, token);
+		return NO_NODE;
 	}
 
-	// Populate parse node as binary parse node.
-	binary_node->type = BINARY_NODE;
-	binary_node->node.binary = *binary;
-
-	return binary_node;
+	NodeId node = new_node(BINARY_NODE);
+	BinaryNode *binary = &arena_at(node)->node.binary;
+	binary->op = infix->kind;
+	binary->left = adopt(node, left);
+	binary->right = adopt(node, right);
+	return node;
 }
 
-ParseNode *parse_expr(char **slice, iprec precedence)
+static NodeId parse_expr(TokenStream *ts, iprec precedence)
 {
-	Token *token = peek(slice);
+	const Token *token = peek(ts);
 
 	if (token == NULL)
-		return NULL;
+		return NO_NODE;
 
 	// Never consume a `)` or `in` token.
 	switch (token->type) {
-		case TT_RPAREN: return NULL;
-		case TT_IDENTIFIER: if (strcmp(token->value, "in") == 0) return NULL;
+		case TT_RPAREN: return NO_NODE;
+		case TT_IDENTIFIER: if (token_is(ts, token, "in")) return NO_NODE;
 		default: break;
 	}
 
 	// Advance tokens.
-	token = lex(slice);
-	ParseNode *left = parse_prefix(token, slice);
-
+	token = next_token(ts);
+	NodeId left = parse_prefix(token, ts);
 
-	if (left == NULL)
-		return NULL;
+	if (left == NO_NODE)
+		return NO_NODE;
 
-	Token *token_ahead = peek(slice);
+	const Token *token_ahead = peek(ts);
 
 	if (token_ahead == NULL)
 		return left;
 
-	iprec current_precedence = token_precedence(token_ahead);
+	iprec current_precedence = token_precedence(ts, token_ahead);
 	iprec previous_precedence = min_prec;
 
-	usize count = 0;
+	// Every step consumes at least one token, so this terminates.
 	while (precedence < current_precedence) {
-		count += 1;
-		if (count > 301) {
-			ERROR_TYPE = PARSE_ERROR;
-			strcpy(ERROR_MSG, "Could not finish parsing expression.");
-			break;
-		}
+		// Function application does not consume a token.
 		token = current_precedence == FUNCTION_PRECEDENCE
-			? peek(slice)
-			:  lex(slice);
+			? peek(ts)
+			: next_token(ts);
 
-		if (token == NULL)
+		left = parse_infix(left, token, ts, previous_precedence);
+		if (left == NO_NODE)
 			break;
 
-		left = parse_infix(left, token, slice, previous_precedence);
-		if (left == NULL || **slice == '\0')
-			break;
-
-		token_ahead = peek(slice);
+		token_ahead = peek(ts);
 		if (token_ahead == NULL)
 			break;
 
 		previous_precedence = current_precedence;
-		current_precedence = token_precedence(token_ahead);
+		current_precedence = token_precedence(ts, token_ahead);
 	}
 
-	if (token_ahead != NULL)
-		free_token((Token *)token_ahead);
-	if (token != NULL)
-		free_token((Token *)token);
 	return left;
 }
 
+/// Parse a statement.  Nodes are built up in the parse arena, then
+/// the finished tree is moved into a block of its own, with the
+/// root as the last node (see `free_parsenode').
 ParseNode *parse(const char *source)
 {
-	char *stepper = strdup(source);
-	char *start = stepper;
-	ParseNode *tree = parse_expr(&stepper, min_prec);
-	free(start);
-	return tree;
+	static TokenStream stream = { 0 };
+	if (!lex(source, &stream))
+		return NULL;
+
+	arena.len = 0;  // Discard any previous statement.
+	NodeId root = parse_expr(&stream, min_prec);
+	if (root == NO_NODE)
+		return NULL;
+	// Post-order, so the root was made last and spans the arena.
+	return clone_node(arena_at(root));
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "defaults.h"
+#include "symbol.h"
 
 // Tokens:
 typedef enum {
@@ -12,12 +13,25 @@ typedef enum {
 	TT_NONE,
 } TokenType;
 
+struct _operator;
+
+/// A token is a slice of the source it was lexed from.
 typedef struct {
 	TokenType type;
-	const char *value;
+	u32 offset;
+	u32 len;
+	// For TT_OPERATOR tokens, the operator in prefix position
+	// and the operator in infix/postfix position (either may be NULL).
+	const struct _operator *prefix;
+	const struct _operator *infix;
 } Token;
 
-Token *new_token(TokenType, const char *);
+/// All the tokens of a source string, lexed up front.
+typedef struct {
+	const char *source;
+	array(Token) tokens;
+	usize next;  // Index of the next token to be consumed.
+} TokenStream;
 
 /* Operator properties. */
 
@@ -38,43 +52,76 @@ typedef enum {
 	POSTFIX,
 } Fixity;
 
-typedef struct {
+/// Operators are resolved when parsing, nodes carry their kind.
+typedef enum {
+	OPR_NONE,  // Not an operator, i.e. function application.
+	OPR_WHERE,
+	OPR_NOT,
+	OPR_SPLAT,
+	OPR_STARSTAR,
+	OPR_LEQ,
+	OPR_GEQ,
+	OPR_EQ,
+	OPR_NEQ,
+	OPR_ARROW,
+	OPR_NEG,
+	OPR_POS,
+	OPR_LNOT,
+	OPR_FACTORIAL,
+	OPR_CARET,
+	OPR_MUL,
+	OPR_DIV,
+	OPR_ADD,
+	OPR_SUB,
+	OPR_GT,
+	OPR_LT,
+	OPR_ASSIGN,
+	OPR_COMMA,
+	OPR_RANGE,
+	OPR_SEMICOLON,
+	OPR_LET_IN,  // `let ... in ...', not lexed as an operator.
+	OPERATOR_KINDS  //< Always last!
+} OperatorKind;
+
+typedef struct _operator {
 	const char *value;
 	iprec precedence;
 	Associativity assoc;
 	Fixity fixity;
+	OperatorKind kind;
 } Operator;
 
 static const iprec FUNCTION_PRECEDENCE = 90;
 // Known operators from longest to shortests.
 static const Operator KNOWN_OPERATORS[] = {
     // 4 characters long.
-    { "where", 5, RIGHT_ASSOC, INFIX },
+    { "where", 5, RIGHT_ASSOC, INFIX, OPR_WHERE },
 	// 3 characters long.
-	{ "not", 25, RIGHT_ASSOC, PREFIX },
-	{ "...", 45,  LEFT_ASSOC, PREFIX },
+	{ "not", 25, RIGHT_ASSOC, PREFIX, OPR_NOT },
+	{ "...", 45,  LEFT_ASSOC, PREFIX, OPR_SPLAT },
 	// 2 characters long.
-	{ "**", 100, RIGHT_ASSOC, INFIX },
-	{ "<=",  40,  LEFT_ASSOC, INFIX },
-	{ ">=",  40,  LEFT_ASSOC, INFIX },
-	{ "==",  30,  LEFT_ASSOC, INFIX },
-	{ "/=",  30,  LEFT_ASSOC, INFIX },
-	{ "->",  25, RIGHT_ASSOC, INFIX },
+	{ "**", 100, RIGHT_ASSOC, INFIX, OPR_STARSTAR },
+	{ "<=",  40,  LEFT_ASSOC, INFIX, OPR_LEQ },
+	{ ">=",  40,  LEFT_ASSOC, INFIX, OPR_GEQ },
+	{ "==",  30,  LEFT_ASSOC, INFIX, OPR_EQ },
+	{ "/=",  30,  LEFT_ASSOC, INFIX, OPR_NEQ },
+	{ "->",  25, RIGHT_ASSOC, INFIX, OPR_ARROW },
 	// 1 character long.
-	{ "-", 100, RIGHT_ASSOC, PREFIX },
-	{ "+", 100, RIGHT_ASSOC, PREFIX },
-	{ "¬", 100, RIGHT_ASSOC, PREFIX },
-	{ "!", 100,  LEFT_ASSOC, POSTFIX },
-	{ "^", 100, RIGHT_ASSOC, INFIX },
-	{ "*",  60,  LEFT_ASSOC, INFIX },
-	{ "/",  60,  LEFT_ASSOC, INFIX },
-	{ "+",  50,  LEFT_ASSOC, INFIX },
-	{ "-",  50,  LEFT_ASSOC, INFIX },
-	{ ">",  40,  LEFT_ASSOC, INFIX },
-	{ "<",  40,  LEFT_ASSOC, INFIX },
-	{ "=",  20, RIGHT_ASSOC, INFIX },
-	{ ",",  10, RIGHT_ASSOC, INFIX },
-	{ ";",   1,  LEFT_ASSOC, INFIX },
+	{ "-", 100, RIGHT_ASSOC, PREFIX, OPR_NEG },
+	{ "+", 100, RIGHT_ASSOC, PREFIX, OPR_POS },
+	{ "¬", 100, RIGHT_ASSOC, PREFIX, OPR_LNOT },
+	{ "!", 100,  LEFT_ASSOC, POSTFIX, OPR_FACTORIAL },
+	{ "^", 100, RIGHT_ASSOC, INFIX, OPR_CARET },
+	{ "*",  60,  LEFT_ASSOC, INFIX, OPR_MUL },
+	{ "/",  60,  LEFT_ASSOC, INFIX, OPR_DIV },
+	{ "+",  50,  LEFT_ASSOC, INFIX, OPR_ADD },
+	{ "-",  50,  LEFT_ASSOC, INFIX, OPR_SUB },
+	{ ">",  40,  LEFT_ASSOC, INFIX, OPR_GT },
+	{ "<",  40,  LEFT_ASSOC, INFIX, OPR_LT },
+	{ "=",  20, RIGHT_ASSOC, INFIX, OPR_ASSIGN },
+	{ ":",  45, NEITHER_ASSOC, INFIX, OPR_RANGE },
+	{ ",",  10, RIGHT_ASSOC, INFIX, OPR_COMMA },
+	{ ";",   1,  LEFT_ASSOC, INFIX, OPR_SEMICOLON },
 	/* left paren is only zero-precedence op: { "(", 0, ... } */
 };
 
@@ -87,15 +134,19 @@ typedef enum {
 	BINARY_NODE,
 } NodeType;
 
-struct _parse_node;
+/// Parse trees are stored in post-order in one contiguous block of
+/// nodes, children are referred to by their distance back from the
+/// parent.  So, a subtree is the `size' nodes ending at its root,
+/// and may be copied or freed as a single block.
+typedef u32 NodeRef;
 
 typedef struct {
-	char *value;
+	Symbol symbol;
 } IdentNode;
 
 typedef struct {
 	usize len;
-	byte *value;
+	const byte *value;  // Interned, never freed.
 } StringNode;
 
 typedef enum {
@@ -103,6 +154,7 @@ typedef enum {
 	INT,
 	BIGINT, // Not supported yet.
 	RATIO,  // Not supported yet.
+	NUMBER_TYPES
 } NumberType;
 
 typedef struct {
@@ -114,20 +166,24 @@ typedef struct {
 	} value;
 } NumberNode;
 
+/// Either a prefix/postfix operator (`op'), or the application
+/// of `callee' to `operand' (when `op' is OPR_NONE).
 typedef struct {
-	const struct _parse_node *callee;
-	const struct _parse_node *operand;
+	OperatorKind op;
+	NodeRef callee;
+	NodeRef operand;
 	bool is_postfix;
 } UnaryNode;
 
 typedef struct {
-	const struct _parse_node *callee;
-	const struct _parse_node *left;
-	const struct _parse_node *right;
+	OperatorKind op;
+	NodeRef left;
+	NodeRef right;
 } BinaryNode;
 
 typedef struct _parse_node {
 	NodeType type;
+	u32 size;  // Number of nodes in this subtree, including itself.
 	union {
 		IdentNode ident;
 		StringNode str;
@@ -137,18 +193,54 @@ typedef struct _parse_node {
 	} node;
 } ParseNode;
 
+static inline const ParseNode *unary_callee(const ParseNode *node)
+{ return node - node->node.unary.callee; }
+
+static inline const ParseNode *unary_operand(const ParseNode *node)
+{ return node - node->node.unary.operand; }
+
+static inline const ParseNode *binary_left(const ParseNode *node)
+{ return node - node->node.binary.left; }
+
+static inline const ParseNode *binary_right(const ParseNode *node)
+{ return node - node->node.binary.right; }
+
 // Functions:
 
-void free_token(Token *);
+/// Function application `f x' (as opposed to a prefix/postfix operator).
+static inline bool is_application(const ParseNode *node)
+{
+	return node->type == UNARY_NODE && node->node.unary.op == OPR_NONE;
+}
+
+/// Use of the given (prefix, postfix or infix) operator.
+static inline bool is_operation(const ParseNode *node, OperatorKind op)
+{
+	return (node->type == UNARY_NODE && node->node.unary.op == op)
+		|| (node->type == BINARY_NODE && node->node.binary.op == op);
+}
+
+/// Take the next element of a chain of the tuple (,) operator,
+/// `(a, b, ..., z)', leaving `*chain' at the rest (NULL after the last).
+static inline const ParseNode *next_element(const ParseNode **chain)
+{
+	const ParseNode *node = *chain;
+	if (!is_operation(node, OPR_COMMA)) {
+		*chain = NULL;
+		return node;
+	}
+	*chain = binary_right(node);
+	return binary_left(node);
+}
+
+const char *operator_name(OperatorKind);
 void free_parsenode(ParseNode *);
 ParseNode *clone_node(const ParseNode *);
 
-Token *lex(char **);
-Token *peek(char **);
+bool lex(const char *, TokenStream *);
+const Token *peek(const TokenStream *);
+const Token *next_token(TokenStream *);
 
 NumberNode *make_number(NumberType, void *);
-NumberNode *parse_number(const char *);
-ParseNode *parse_prefix(const Token *, char **);
-ParseNode *parse_infix(const ParseNode *, const Token *, char **, iprec);
-ParseNode *parse_expr(char **, iprec);
+bool parse_number(const char *, usize, NumberNode *);
 ParseNode *parse(const char *);
@@ -0,0 +1,27 @@
+#include "pool.h"
+
+// Objects per slab.
+#define SLAB_OBJECTS 512
+
+/// Take a new object from the slab, starting a new slab when the
+/// current one is used up.
+void *pool_carve(Pool *pool)
+{
+	++pool->misses;
+	if (pool->slab_left == 0) {
+		pool->slab = malloc(pool->size * SLAB_OBJECTS);
+		pool->slab_left = SLAB_OBJECTS;
+	}
+	void *object = pool->slab;
+	pool->slab += pool->size;
+	--pool->slab_left;
+	return object;
+}
+
+void display_pool(FILE *file, const Pool *pool)
+{
+	usize total = pool->hits + pool->misses;
+	fprintf(file, "%-10s %10zu hits %10zu misses (%5.1f%% hit rate)\n",
+		pool->name, pool->hits, pool->misses,
+		total == 0 ? 0.0 : 100.0 * pool->hits / total);
+}
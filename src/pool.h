@@ -0,0 +1,50 @@
+#pragma once
+
+#include "defaults.h"
+
+/// A pool of small objects of one size.  Objects are carved out of
+/// large slabs, and freed ones are kept on a free list to be handed
+/// out again, so the churn of reference counting stays out of `malloc'.
+/// Slabs are never given back.  Build with -DNO_POOLS to allocate
+/// every object with `malloc' instead, for ASan and friends.
+typedef struct {
+	const char *name;
+	usize size;       // At least the size of a pointer.
+	void *free_list;  // Freed objects, linked through their first word.
+	byte *slab;       // Unused part of the newest slab.
+	usize slab_left;  // Objects left in it.
+	usize hits;       // Allocations served from the free list.
+	usize misses;     // Allocations carved from a slab (or malloc'd).
+} Pool;
+
+#define POOL(TYPE) { .name = #TYPE, \
+	.size = sizeof(TYPE) < sizeof(void *) ? sizeof(void *) : sizeof(TYPE) }
+
+void *pool_carve(Pool *);
+void display_pool(FILE *, const Pool *);
+
+static inline void *pool_alloc(Pool *pool)
+{
+#ifdef NO_POOLS
+	++pool->misses;
+	return malloc(pool->size);
+#else
+	void *object = pool->free_list;
+	if (object == NULL)
+		return pool_carve(pool);
+	++pool->hits;
+	pool->free_list = *(void **)object;
+	return object;
+#endif
+}
+
+static inline void pool_free(Pool *pool, void *object)
+{
+#ifdef NO_POOLS
+	UNUSED(pool);
+	free(object);
+#else
+	*(void **)object = pool->free_list;
+	pool->free_list = object;
+#endif
+}
@@ -1,4 +1,5 @@
 #include "prelude.h"
+#include "fold.h"
 
 char *PRELUDE_STATEMENTS[] = {
 	"tau = 2pi",
@@ -14,12 +15,17 @@ void execute_prelude(Context *ctx)
 		ParseNode *stmt = parse(stmt_str);
 		if (stmt == NULL || ERROR_TYPE != NO_ERROR)
 			goto fatality;
+		if (folding)
+			stmt = fold(ctx, stmt);
 
 		DataValue *result = execute(ctx, stmt);
 		if (result == NULL || ERROR_TYPE != NO_ERROR)
 			goto fatality;
 
-		free(stmt);
+		// Prelude definitions are as constant as the builtins.
+		if (is_operation(stmt, OPR_ASSIGN) && binary_left(stmt)->type == IDENT_NODE)
+			mark_constant(ctx, binary_left(stmt)->node.ident.symbol);
+		free_parsenode(stmt);
 	}
 	return;
 
@@ -0,0 +1,107 @@
+#include "symbol.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const PREDEFINED_NAMES[PREDEFINED_SYMBOLS] = {
+	[SYM_Ans] = "Ans",
+	[SYM_ans] = "ans",
+	[SYM__] = "_",
+	[SYM_MAIN] = "<main>",
+	[SYM_ANON] = "<anon>",
+	[SYM_CURRIED] = "<curried>",
+	[SYM_LET_CLAUSE] = "<let-clause>",
+	[SYM_LET_EXPR] = "<let-expr>",
+	[SYM_WHERE_CLAUSE] = "<where-clause>",
+	[SYM_WHERE_EXPR] = "<where-expr>",
+};
+
+// Every name interned so far, indexed by symbol.  Names live as long
+// as the program, so they may be shared freely and are never freed.
+static array(const char *) names = { 0 };
+
+// Open addressing hash table of (symbol + 1), zero marks a free slot.
+static struct {
+	usize cap;  // Always a power of two.
+	Symbol *buf;
+} table = { 0 };
+
+static u32 hash_bytes(const char *str, usize len)
+{
+	u32 hash = 2166136261u;  // FNV-1a.
+	for (usize i = 0; i < len; ++i) {
+		hash ^= (byte)str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static void rehash(usize cap)
+{
+	Symbol *buf = calloc(cap, sizeof(Symbol));
+	for (Symbol sym = 0; sym < names.len; ++sym) {
+		const char *name = names.buf[sym];
+		usize i = hash_bytes(name, strlen(name)) & (cap - 1);
+		while (buf[i] != 0) i = (i + 1) & (cap - 1);
+		buf[i] = sym + 1;
+	}
+	free(table.buf);
+	table.buf = buf;
+	table.cap = cap;
+}
+
+static Symbol insert(const char *str, usize len)
+{
+	// Keep load below half.
+	if (2 * (names.len + 1) > table.cap)
+		rehash(table.cap == 0 ? 256 : 2 * table.cap);
+
+	usize i = hash_bytes(str, len) & (table.cap - 1);
+	for (; table.buf[i] != 0; i = (i + 1) & (table.cap - 1)) {
+		const char *name = names.buf[table.buf[i] - 1];
+		if (strncmp(name, str, len) == 0 && name[len] == '\0')
+			return table.buf[i] - 1;
+	}
+
+	char *copy = malloc(len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	push(const char *, &names, copy);
+	table.buf[i] = names.len;
+	return names.len - 1;
+}
+
+static inline void predefine_symbols(void)
+{
+	if (names.len != 0)
+		return;
+	for (usize i = 0; i < PREDEFINED_SYMBOLS; ++i)
+		insert(PREDEFINED_NAMES[i], strlen(PREDEFINED_NAMES[i]));
+}
+
+/// Find or insert the name `str' of length `len' (need not
+/// be null-terminated), returning its symbol.
+Symbol intern_symbol(const char *str, usize len)
+{
+	predefine_symbols();
+	return insert(str, len);
+}
+
+/// Symbol of a null-terminated name.
+Symbol symbol(const char *name)
+{
+	return intern_symbol(name, strlen(name));
+}
+
+const char *symbol_name(Symbol sym)
+{
+	predefine_symbols();
+	return names.buf[sym];
+}
+
+/// Unique, null-terminated copy of a string, shared by all
+/// equal strings (see `intern_symbol').
+const char *intern(const char *str, usize len)
+{
+	return symbol_name(intern_symbol(str, len));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "defaults.h"
+
+/// Identifiers are interned once, when lexed, and referred to by a
+/// small integer from then on.  Equal names have equal symbols, so
+/// comparing names is comparing integers.
+typedef u32 Symbol;
+
+/// Symbols the interpreter itself needs, always defined.
+typedef enum {
+	SYM_Ans,
+	SYM_ans,
+	SYM__,
+	SYM_MAIN,
+	SYM_ANON,
+	SYM_CURRIED,
+	SYM_LET_CLAUSE,
+	SYM_LET_EXPR,
+	SYM_WHERE_CLAUSE,
+	SYM_WHERE_EXPR,
+	PREDEFINED_SYMBOLS  //< Always last!
+} PredefinedSymbol;
+
+Symbol intern_symbol(const char *, usize);
+Symbol symbol(const char *);
+const char *symbol_name(Symbol);
+const char *intern(const char *, usize);
@@ -0,0 +1,454 @@
+#include "vm.h"
+#include "error.h"
+#include "builtin.h"
+#include "memo.h"
+#include "jit.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static VM vm = { 0 };
+
+// How often the inline caches of load sites are of use.
+static usize load_hits = 0, load_misses = 0;
+
+static inline void push_value(DataValue *value)
+{
+	push(DataValue *, &vm.stack, value);
+}
+
+static inline DataValue *pop_value(void)
+{
+	return vm.stack.buf[--vm.stack.len];
+}
+
+static void push_frame(const Chunk *chunk, Context *ctx, bool owns_base)
+{
+	push(Frame, &vm.frames, ((Frame){
+		.chunk = chunk,
+		.ip = chunk->code.buf,
+		.ctx = ctx,
+		.base = ctx,
+		.owns_base = owns_base,
+		.stack_base = vm.stack.len,
+		.memo = NULL,
+		.callee = NULL,
+	}));
+}
+
+/// Leave every scope a frame entered, and its own context if it has one.
+static void drop_frame(Frame *frame)
+{
+	while (frame->ctx != frame->base) {
+		Context *superior = frame->ctx->superior;
+		pop_context(frame->ctx);
+		frame->ctx = superior;
+	}
+	if (frame->owns_base)
+		pop_context(frame->base);
+	if (frame->memo != NULL)
+		unlink_datavalue(frame->memo_key);
+	if (frame->callee != NULL)
+		unlink_datavalue(frame->callee);
+}
+
+/// Leave a function frame ahead of a call in tail position, so the
+/// callee takes its place.  What is left of the frame only exports
+/// and leaves scopes (see `mark_tail_call'), which is done first.
+/// The callee and operand stay on top of the stack.
+static void leave_for_tail_call(Frame *frame, const Instr *ip)
+{
+	DataValue *operand = pop_value();
+	DataValue *callee = pop_value();
+	for (; INSTR_OP(*ip) != OP_RETURN; ++ip) {
+		if (INSTR_OP(*ip) == OP_EXPORT) {
+			export_locals(frame->ctx, frame->ctx->superior->superior);
+		} else if (INSTR_OP(*ip) == OP_LEAVE) {
+			Context *superior = frame->ctx->superior;
+			pop_context(frame->ctx);
+			frame->ctx = superior;
+		}
+	}
+	// Values the scopes would have discarded (OP_NIP).
+	while (vm.stack.len > frame->stack_base)
+		unlink_datavalue(pop_value());
+	drop_frame(frame);
+	--vm.frames.len;
+	push_value(callee);
+	push_value(operand);
+}
+
+/// Apply a lambda to an operand.  Either a new frame is pushed to
+/// evaluate the body of the matching pattern (returns NULL), or the
+/// result is produced immediately (curried patterns).
+/// On failure, NULL is returned with ERROR_TYPE set.
+static DataValue *call_lambda(Lambda *lambda, DataValue *operand)
+{
+	if (lambda->memo != NULL) {
+		DataValue *remembered = memo_lookup(lambda->memo, operand);
+		if (remembered != NULL)
+			return link_datavalue(remembered);
+	}
+	if (may_run_native(lambda)) {
+		DataValue *result = call_native(lambda, operand);
+		if (result != NULL) {
+			if (lambda->memo != NULL)
+				memo_store(lambda->memo, operand, result);
+			return result;
+		}
+	}
+	// Make the function call frame / local execution context.
+	Context *local_ctx = push_context(lambda->name, lambda->scope,
+		frame_size(lambda));
+	const LambdaPattern *lampat = match_lambda(local_ctx, lambda, operand);
+	if (lampat != NULL) {
+		switch (lampat->body_type) {
+		case ParseNodeBody:
+			// Frame takes ownership of the local context.
+			push_frame(lampat->chunk, local_ctx, true);
+			if (lambda->memo != NULL) {
+				// Result is remembered on return.
+				Frame *frame = &vm.frames.buf[vm.frames.len - 1];
+				frame->memo = lambda->memo;
+				frame->memo_key = link_datavalue(operand);
+			}
+			return NULL;
+		case LambdaBody: {
+			Lambda *nested_lambda = copy_lambda(lampat->lambda, local_ctx);
+			pop_context(local_ctx);
+			DataValue *result = heap_data(T_LAMBDA, nested_lambda);
+			if (lambda->memo != NULL)
+				memo_store(lambda->memo, operand, result);
+			return result;
+		}
+		}
+	}
+	// Never matched.
+	pop_context(local_ctx);
+	ERROR_TYPE = EXECUTION_ERROR;
+	strcpy(ERROR_MSG, "No branch of the function matched against this argument.");
+	return NULL;
+}
+
+/// Find a variable by name, searching from `scope' outwards.  Searches
+/// from a global scope are cached for the site until `binding_epoch'
+/// changes, others depend on scopes which come and go with calls.
+static inline Local *resolve(const Context *scope, const Address *addr, LoadCache *cache)
+{
+	if (scope->superior != NULL)
+		return search_locals(scope, addr->name);
+	if (cache->scope == scope && cache->epoch == binding_epoch) {
+		++load_hits;
+		return cache->local;
+	}
+	++load_misses;
+	Local *local = search_locals(scope, addr->name);
+	*cache = (LoadCache){ binding_epoch, scope, local };
+	return local;
+}
+
+/// Join the top `count' values of the stack into one tuple, which
+/// replaces them.  False (with an error) if it cannot be built.
+static bool build_tuple(usize count, const bool *splats)
+{
+	vm.stack.len -= count;
+	DataValue **elements = &vm.stack.buf[vm.stack.len];
+	DataValue *tuple = join_tuple(elements, count, splats);
+	for (usize i = 0; i < count; ++i)
+		unlink_datavalue(elements[i]);
+	if (tuple == NULL)
+		return false;
+	push_value(tuple);
+	return true;
+}
+
+/// Push the parts of a tuple that a tuple pattern of `count' elements
+/// matches, the first on top.  Those are its items, except that the
+/// last part of a splatted pattern is the rest of them, sharing the
+/// items of the tuple.  False if the value has another shape (see
+/// `match_local'), with nothing pushed.
+static bool unpack_tuple(DataValue *value, usize count, bool splat)
+{
+	if (value->type != T_TUPLE)
+		return false;
+	const Tuple *tuple = value->value;
+	if (tuple->length < count || (tuple->length != count && !splat))
+		return false;
+	usize last = count - 1;
+	usize remaining = tuple->length - last;
+	push_value(remaining == 1
+		? tuple_item(tuple, last)
+		: slice_tuple(value, last, remaining));
+	for (usize i = last; i-- > 0;)
+		push_value(tuple_item(tuple, i));
+	return true;
+}
+
+/// Operands proven to be numbers by the compiler (ARITH_UNCHECKED) go
+/// straight to the arithmetic, others are checked and dispatched on
+/// their types.
+#define ARITHMETIC(OPERATOR, OPERATION) do { \
+	DataValue *rhs = pop_value(); \
+	DataValue *lhs = pop_value(); \
+	DataValue *result = arg & ARITH_UNCHECKED \
+		? unchecked_operation(OPERATION, lhs, rhs) \
+		: binary_operation(OPERATOR, lhs, rhs); \
+	unlink_datavalue(lhs); \
+	unlink_datavalue(rhs); \
+	if (result == NULL) goto error; \
+	push_value(result); \
+} while (0)
+
+/// Run a compiled chunk in the given context, until it returns.
+/// Function calls push new frames instead of recursing, so the depth
+/// of user recursion is not limited by the C stack.
+/// Returns the resulting value, or NULL on error (see ERROR_TYPE).
+DataValue *run_chunk(Context *ctx, const Chunk *chunk)
+{
+	// May be re-entered, only frames and values above these are ours.
+	usize frames_base = vm.frames.len;
+	usize stack_base = vm.stack.len;
+
+	push_frame(chunk, ctx, false);
+	Frame *frame = &vm.frames.buf[vm.frames.len - 1];
+	const Instr *ip = frame->ip;
+	Symbol undefined;  // Variable that could not be found.
+
+	for (;;) {
+		Instr ins = *ip++;
+		u32 arg = INSTR_ARG(ins);
+		switch (INSTR_OP(ins)) {
+		case OP_CONSTANT:
+			push_value(link_datavalue(frame->chunk->constants.buf[arg]));
+			break;
+		case OP_LOAD: {
+			const Address *addr = &frame->chunk->addresses.buf[arg];
+			Local *local = resolve(frame->ctx, addr,
+				&frame->chunk->load_caches[arg]);
+			if (local == NULL) {
+				undefined = addr->name;
+				goto undefined_variable;
+			}
+			push_value(link_datavalue(local->value));
+			break;
+		}
+		case OP_LOAD_LOCAL: {
+			const Address *addr = &frame->chunk->addresses.buf[arg];
+			const Context *scope = frame->ctx;
+			for (u32 i = 0; i < addr->depth; ++i)
+				scope = scope->superior;
+			const Local *local = &scope->locals[addr->slot];
+			// Compiler and runtime must agree on where locals live.
+			assert(addr->slot < scope->locals_count && local->name == addr->name);
+			push_value(link_datavalue(local->value));
+			break;
+		}
+		case OP_LOAD_OUTER: {
+			const Address *addr = &frame->chunk->addresses.buf[arg];
+			const Context *scope = frame->ctx;
+			for (u32 i = 0; i < addr->depth; ++i)
+				scope = scope->superior;
+			Local *local = resolve(scope, addr,
+				&frame->chunk->load_caches[arg]);
+			if (local == NULL) {
+				undefined = addr->name;
+				goto undefined_variable;
+			}
+			push_value(link_datavalue(local->value));
+			break;
+		}
+		case OP_TAIL_CALL:
+			// Only function frames can be replaced, others belong
+			// to whoever called `run_chunk'.  Frames remembering
+			// their result must see it returned.
+			if (frame->owns_base && frame->memo == NULL
+			&& vm.stack.buf[vm.stack.len - 2]->type == T_LAMBDA) {
+				leave_for_tail_call(frame, ip);
+				frame = &vm.frames.buf[vm.frames.len - 1];
+				ip = frame->ip;
+			}
+			goto call;
+		case OP_CALL:
+		call: {
+			DataValue *operand = pop_value();
+			DataValue *callee = pop_value();
+			DataValue *result = NULL;
+			switch (callee->type) {
+			case T_LAMBDA:
+				frame->ip = ip;
+				result = call_lambda(callee->value, operand);
+				if (result == NULL && ERROR_TYPE == NO_ERROR) {
+					// Entered the body in a new frame, which keeps
+					// the lambda, with its body, until it returns.
+					frame = &vm.frames.buf[vm.frames.len - 1];
+					frame->callee = link_datavalue(callee);
+					ip = frame->ip;
+				}
+				break;
+			case T_FUNCTION_PTR:
+				result = ((FnPtr *)callee->value)->fn(*operand);
+				break;
+			default:
+				result = apply_primitive(callee, operand);
+			}
+			unlink_datavalue(callee);
+			unlink_datavalue(operand);
+			if (ERROR_TYPE != NO_ERROR) {
+				if (result != NULL) unlink_datavalue(result);
+				goto error;
+			}
+			if (result != NULL)
+				push_value(result);
+			break;
+		}
+		case OP_ADD: ARITHMETIC(OPR_ADD, num_add); break;
+		case OP_SUB: ARITHMETIC(OPR_SUB, num_sub); break;
+		case OP_MUL: ARITHMETIC(OPR_MUL, num_mul); break;
+		case OP_DIV: ARITHMETIC(OPR_DIV, num_div); break;
+		case OP_POW: ARITHMETIC(OPR_CARET, num_pow); break;
+		case OP_UNARY: {
+			DataValue *operand = pop_value();
+			DataValue *result = unary_operation(arg, operand);
+			unlink_datavalue(operand);
+			if (result == NULL) goto error;
+			push_value(result);
+			break;
+		}
+		case OP_TUPLE:
+			if (!build_tuple(arg, NULL))
+				goto error;
+			break;
+		case OP_TUPLE_SPLAT: {
+			const TupleShape *shape = &frame->chunk->shapes.buf[arg];
+			if (!build_tuple(shape->count, &frame->chunk->splats.buf[shape->splats]))
+				goto error;
+			break;
+		}
+		case OP_RANGE: {
+			DataValue *rhs = pop_value();
+			DataValue *lhs = pop_value();
+			DataValue *range = make_range(lhs, rhs);
+			unlink_datavalue(lhs);
+			unlink_datavalue(rhs);
+			if (range == NULL) goto error;
+			push_value(range);
+			break;
+		}
+		case OP_DUP:
+			push_value(link_datavalue(vm.stack.buf[vm.stack.len - 1]));
+			break;
+		case OP_MATCH_NAME: {
+			DataValue *value = pop_value();
+			bind_local(frame->ctx, arg, value);
+			unlink_datavalue(value);
+			break;
+		}
+		case OP_MATCH_TUPLE: {
+			DataValue *value = pop_value();
+			bool matched = unpack_tuple(value, MATCH_COUNT(arg), MATCH_SPLAT(arg));
+			unlink_datavalue(value);
+			if (!matched) goto mismatch;
+			break;
+		}
+		case OP_MATCH: {
+			DataValue *value = pop_value();
+			bool matched = match_local(frame->ctx, frame->chunk->nodes.buf[arg], value);
+			unlink_datavalue(value);
+			if (!matched) goto mismatch;
+			break;
+		}
+		case OP_DEFINE: {
+			const ParseNode *defn = frame->chunk->nodes.buf[arg];
+			const ParseNode *call = binary_left(defn);
+			Lambda *lam = register_lambda_pattern(frame->ctx, call, binary_right(defn));
+			if (lam == NULL) goto error;
+			Local *found = search_locals(frame->ctx, lam->name);
+			if (found == NULL) {
+				// Bind the lambda in this scope if it does not exist yet.
+				DataValue *data = heap_data(T_LAMBDA, lam);
+				bind_local(frame->ctx, lam->name, data);
+				push_value(data);
+			} else {
+				// Othwise, just return a reference to the lambda.
+				push_value(link_datavalue(found->value));
+			}
+			break;
+		}
+		case OP_LAMBDA: {
+			Lambda *lam = copy_lambda(frame->chunk->lambdas.buf[arg], frame->ctx);
+			push_value(heap_data(T_LAMBDA, lam));
+			break;
+		}
+		case OP_ENTER:
+			frame->ctx = push_context(arg, frame->ctx, 0);
+			break;
+		case OP_EXPORT:
+			export_locals(frame->ctx, frame->ctx->superior->superior);
+			break;
+		case OP_LEAVE: {
+			Context *superior = frame->ctx->superior;
+			pop_context(frame->ctx);
+			frame->ctx = superior;
+			break;
+		}
+		case OP_POP:
+			unlink_datavalue(pop_value());
+			break;
+		case OP_NIP: {
+			DataValue *top = pop_value();
+			unlink_datavalue(pop_value());
+			push_value(top);
+			break;
+		}
+		case OP_FAIL: {
+			ERROR_TYPE = EXECUTION_ERROR;
+			sprintf(ERROR_MSG, "Do not know how to evaluate"
+				" use of `%s' operator.", operator_name(arg));
+			goto error;
+		}
+		case OP_RETURN: {
+			// Result stays on the stack for the caller.
+			if (frame->memo != NULL)
+				memo_store(frame->memo, frame->memo_key,
+					vm.stack.buf[vm.stack.len - 1]);
+			drop_frame(frame);
+			--vm.frames.len;
+			if (vm.frames.len == frames_base)
+				return pop_value();
+			frame = &vm.frames.buf[vm.frames.len - 1];
+			ip = frame->ip;
+			break;
+		}
+		default:
+			fprintf(stderr, "unknown opcode: %d\n", INSTR_OP(ins));
+			exit(2);
+		}
+	}
+
+undefined_variable:
+	ERROR_TYPE = EXECUTION_ERROR;
+	sprintf(ERROR_MSG, "Could not find variable `%s'\n"
+		"  in any local or superior scope.", symbol_name(undefined));
+	goto error;
+mismatch:
+	ERROR_TYPE = EXECUTION_ERROR;
+	strcpy(ERROR_MSG, "Mismatched left hand side of expression.");
+error:
+	// Unwind everything this invocation pushed.
+	while (vm.frames.len > frames_base)
+		drop_frame(&vm.frames.buf[--vm.frames.len]);
+	while (vm.stack.len > stack_base)
+		unlink_datavalue(pop_value());
+	return NULL;
+}
+
+/// Report how well the inline caches are doing.
+void display_caches(FILE *file)
+{
+	usize loads = load_hits + load_misses;
+	fprintf(file, "%-10s %10zu hits %10zu misses (%5.1f%% hit rate)\n",
+		"LoadCache", load_hits, load_misses,
+		loads == 0 ? 0.0 : 100.0 * load_hits / loads);
+}
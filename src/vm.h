@@ -0,0 +1,27 @@
+#pragma once
+
+#include "defaults.h"
+#include "compile.h"
+#include "execute.h"
+
+/// A call frame: a chunk being run, and the scope it runs in.
+typedef struct {
+	const Chunk *chunk;
+	const Instr *ip;
+	Context *ctx;   // Innermost scope, changes with OP_ENTER/OP_LEAVE.
+	Context *base;  // Scope the frame was entered with.
+	bool owns_base; // Function frames own their call context.
+	usize stack_base; // Height of the value stack when entered.
+	struct _memo *memo;   // Remembers the result for `memo_key'.
+	DataValue *memo_key;
+	DataValue *callee;    // Lambda whose body is run, kept while it is.
+} Frame;
+
+/// The stack machine state, shared by nested calls to `run_chunk'.
+typedef struct {
+	array(DataValue *) stack;
+	array(Frame) frames;
+} VM;
+
+DataValue *run_chunk(Context *, const Chunk *);
+void display_caches(FILE *);
@@ -0,0 +1,93 @@
+/* Regression tests, build and run with `make test'. */
+#include "defaults.h"
+#include "error.h"
+#include "parse.h"
+#include "execute.h"
+#include "displays.h"
+#include "vm.h"
+#include "jit.h"
+
+typedef DataValue *(*Evaluator)(Context *, const ParseNode *);
+
+#define MAX_STATEMENTS 16
+
+static const struct {
+	const char *name;
+	const char *statements[MAX_STATEMENTS];  // The last one is checked.
+	const char *expected;
+} CASES[] = {
+	{ "memo, then extend the original function", {
+		"f 0 = 0",
+		"f n = n + 1",
+		"g = memo f",
+		"f 1 = 100",
+		"f 2 = 200",
+		"f 3 = 300",
+		"g 5",
+	}, "6" },
+	{ "extend a copy of a function", {
+		"f 0 = 0",
+		"g = memo f",
+		"f n = 2n",
+		"h = memo f",
+		"f 1 = 100",
+		"(g 0, h 3, f 4)",
+	}, "(0, 6, 8)" },
+};
+
+/// Evaluate each statement of a case in a new context, giving
+/// whether the last one displays as expected.
+static bool passes(Evaluator evaluate, usize i)
+{
+	Context *ctx = base_context();
+	DataValue *result = NULL;
+	for (usize j = 0; CASES[i].statements[j] != NULL; ++j) {
+		if (result != NULL)
+			unlink_datavalue(result);
+		ParseNode *tree = parse(CASES[i].statements[j]);
+		result = evaluate(ctx, tree);
+		free_parsenode(tree);
+		if (result == NULL) {
+			handle_error();
+			break;
+		}
+	}
+	bool passed = false;
+	if (result != NULL) {
+		char *shown = display_datavalue(result);
+		passed = strcmp(shown, CASES[i].expected) == 0;
+		if (!passed)
+			printf("  gave %s, expected %s\n", shown, CASES[i].expected);
+		free(shown);
+		unlink_datavalue(result);
+	}
+	free_context(ctx);
+	return passed;
+}
+
+int main(void)
+{
+	static const struct {
+		const char *name;
+		Evaluator evaluate;
+		bool jit;
+	} EVALUATORS[] = {
+		{ "tree", execute_tree, false },
+		{ "bytecode", execute, false },
+		{ "jit", execute, true },
+	};
+	usize failed = 0;
+	for (usize i = 0; i < len(CASES); ++i) {
+		for (usize e = 0; e < len(EVALUATORS); ++e) {
+			jit_enabled = EVALUATORS[e].jit;
+			bool passed = passes(EVALUATORS[e].evaluate, i);
+			printf("%-6s %-9s %s\n", passed ? "ok" : "FAILED",
+				EVALUATORS[e].name, CASES[i].name);
+			failed += !passed;
+		}
+	}
+	jit_enabled = false;
+	printf("\n%zu of %zu failed.\n",
+		failed, len(CASES) * len(EVALUATORS));
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}